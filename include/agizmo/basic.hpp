@@ -74,12 +74,14 @@ inline OutIt constexpr split(InIt query, const InIt &query_end, SepIt sep,
   if (dist == 1)
     return split<OutType>(query, query_end, *sep, output);
 
-  auto found(search(query, query_end, Comp<SepIt>(sep, sep_end)));
+  // Searcher is built once, its tables are reused for every field.
+  const Comp<SepIt> searcher(sep, sep_end);
+  auto found(search(query, query_end, searcher));
 
   do {
     *output++ = OutType(query, found);
     query = next(found, dist);
-    found = (search(query, query_end, Comp<SepIt>(sep, sep_end)));
+    found = (search(query, query_end, searcher));
   } while (prev(query, dist) != query_end);
 
   return output;
@@ -137,22 +137,30 @@ public:
   Stats verify() {
     auto number_width = static_cast<int>(log10(tests.size())) + 1;
 
+    StringCompose::StringBuilder temp;
     for (const auto &test : tests) {
-      sstream temp;
       auto signature = name + test.args();
-      temp << setw(number_width) << setfill('0') << right << ++result << ") "
-           << signature << " " << setfill(' ')
-           << setw(80 - number_width - signature.size() - 3);
-
-      if (test)
-        temp << passed_str << "\n";
-      else {
+      const auto &status = test ? passed_str : failed_str;
+      // Status is aligned to the right of 80 columns.
+      const auto align = 80 - number_width - 3 -
+                         static_cast<int>(signature.size() + status.size());
+
+      temp.clear();
+      temp.append((++result).size(), static_cast<size_t>(number_width))
+          .append(") ")
+          .append(signature)
+          .append(' ')
+          .append(' ', static_cast<size_t>(std::max(align, 0)))
+          .append(status)
+          .append('\n');
+
+      if (!test) {
         result.addFailure();
-        temp << failed_str << "\n" << test << "\n";
-        failed += temp.str();
+        temp.append(test.str()).append('\n');
+        failed += temp.view();
       }
 
-      message += temp.str();
+      message += temp.view();
     }
 
     return result;
@@ -1,12 +1,45 @@
 #pragma once
 
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <new>
 #include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "uring.hpp"
+
+#ifdef AGIZMO_ZLIB
+#include <zlib.h>
+#endif
 
 namespace AGizmo::Files {
 
@@ -25,6 +58,8 @@ using std::nullopt;
 using runerror = std::runtime_error;
 using std::make_unique;
 using std::unique_ptr;
+using std::vector;
+using Parallel::default_workers;
 
 // inline void open_file(const string &file_name, ifstream &stream) {
 inline void open_file(string_view file_name, ifstream &stream) {
@@ -40,173 +75,872 @@ inline void open_file(string_view file_name, wifstream &stream) {
     throw runerror{"Can't open '" + string(file_name.data()) + "'\n"};
 }
 
-class FileReaderWide {
+// Read-only mapping of a whole file into memory.
+// Empty files are not mapped and yield an empty view.
+class MappedFile {
+private:
+  const char *data{nullptr};
+  size_t length{0};
+
+public:
+  MappedFile() = default;
+  MappedFile(string_view file_name) { open(file_name); }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept { *this = std::move(other); }
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      close();
+      std::swap(data, other.data);
+      std::swap(length, other.length);
+    }
+    return *this;
+  }
+  ~MappedFile() { close(); }
+
+  void open(string_view file_name) {
+    close();
+
+    const string name{file_name};
+    const int fd = ::open(name.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw runerror{"Can't open '" + name + "'\n"};
+
+    struct stat info {};
+    if (fstat(fd, &info) < 0) {
+      ::close(fd);
+      throw runerror{"Can't stat '" + name + "'\n"};
+    }
+
+    if (info.st_size > 0) {
+      void *mapped = mmap(nullptr, static_cast<size_t>(info.st_size),
+                          PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped == MAP_FAILED) {
+        ::close(fd);
+        throw runerror{"Can't map '" + name + "'\n"};
+      }
+      madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+      data = static_cast<const char *>(mapped);
+      length = static_cast<size_t>(info.st_size);
+    }
+
+    ::close(fd);
+  }
+
+  void close() noexcept {
+    if (data)
+      munmap(const_cast<char *>(data), length);
+    data = nullptr;
+    length = 0;
+  }
+
+  const char *begin() const noexcept { return data; }
+  const char *end() const noexcept { return data + length; }
+  size_t size() const noexcept { return length; }
+  string_view view() const noexcept { return {data, length}; }
+};
+
+// Buffer allocated with given alignment, size is rounded up to its multiple.
+class AlignedBuffer {
+private:
+  std::unique_ptr<char, decltype(&std::free)> data{nullptr, &std::free};
+  size_t length{0};
+
+public:
+  AlignedBuffer() = default;
+  AlignedBuffer(size_t size, size_t alignment = 4096) {
+    length =
+        (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment;
+    data.reset(static_cast<char *>(std::aligned_alloc(alignment, length)));
+    if (!data)
+      throw std::bad_alloc{};
+  }
+
+  char *get() const noexcept { return data.get(); }
+  size_t size() const noexcept { return length; }
+};
+
+// Selects how FileReader gets its lines when opening a file by name.
+// Stream reads through ifstream, Block reads large blocks with read(2),
+// ReadAhead does the same on background thread, Mapped maps the whole file
+// and Uring keeps several block reads in flight with io_uring. All except
+// Stream serve lines as views into their buffers.
+enum class ReadMode { Stream, Block, ReadAhead, Mapped, Uring };
+
+constexpr size_t default_block_size{1 << 20};
+
+// Source of lines consumed by FileReader.
+// Function next stores following line (without newline) in line and returns
+// false if nothing could be extracted. View stays valid until the next call.
+// Function good mimics istream::good after getline, so it is false after
+// reading last line not terminated with newline.
+class LineSource {
+protected:
+  bool terminated{true};
+
+public:
+  virtual ~LineSource() = default;
+  virtual bool next(string_view &line) = 0;
+  [[nodiscard]] bool good() const noexcept { return terminated; }
+
+  // Function moves source to byte offset, which has to be start of a line.
+  virtual void seek(uint64_t) {
+    throw runerror{"Line source does not support seeking\n"};
+  }
+};
+
+class StreamSource : public LineSource {
+private:
+  unique_ptr<istream> input;
+  string buffer{};
+
+public:
+  StreamSource(unique_ptr<istream> input) : input{std::move(input)} {}
+
+  bool next(string_view &line) override {
+    getline(*input, buffer);
+    line = buffer;
+    terminated = input->good();
+    return !input->fail();
+  }
+
+  void seek(uint64_t offset) override {
+    input->clear();
+    if (!input->seekg(static_cast<std::streamoff>(offset)))
+      throw runerror{"Can't seek in stream\n"};
+    terminated = true;
+  }
+};
+
+// Line source carving lines out of consecutive chunks of data.
+// Derived classes deliver chunks with fill, lines crossing chunk boundary are
+// stitched together in carry buffer.
+class BufferedSource : public LineSource {
+private:
+  string_view chunk{};
+  string carry{};
+  bool exhausted{false};
+
+protected:
+  // Function stores next chunk of data in chunk and returns false at the end
+  // of input. Previous chunk is no longer used when fill is called.
+  virtual bool fill(string_view &chunk) = 0;
+
+  // Function moves input, so the next chunk starts at offset.
+  virtual void reposition(uint64_t) {
+    throw runerror{"Line source does not support seeking\n"};
+  }
+
+public:
+  void seek(uint64_t offset) override {
+    reposition(offset);
+    chunk = {};
+    carry.clear();
+    exhausted = false;
+    terminated = true;
+  }
+
+  bool next(string_view &line) override {
+    bool carried{false};
+    carry.clear();
+
+    while (true) {
+      if (chunk.empty()) {
+        if (exhausted || !fill(chunk)) {
+          exhausted = true;
+          terminated = false;
+          line = carried ? string_view(carry) : string_view{};
+          return carried;
+        }
+        continue;
+      }
+
+      const auto first = chunk.data();
+      const auto last = first + chunk.size();
+      const auto found = Simd::find_byte(first, last, '\n');
+
+      if (found == last) {
+        carry.append(first, chunk.size());
+        carried = true;
+        chunk = {};
+        continue;
+      }
+
+      const auto length = static_cast<size_t>(found - first);
+      if (carried) {
+        carry.append(first, length);
+        line = carry;
+      } else
+        line = string_view(first, length);
+
+      chunk.remove_prefix(length + 1);
+      terminated = true;
+      return true;
+    }
+  }
+};
+
+// Owner of read-only file descriptor.
+class FileDescriptor {
 private:
-  std::unique_ptr<std::wistream> input{nullptr};
+  int fd{-1};
   string file_name{};
-  wstring line{};
-  long line_num{0};
 
 public:
-  FileReaderWide() = delete;
+  FileDescriptor() = default;
+  FileDescriptor(string_view file_name) : file_name{file_name} {
+    fd = ::open(this->file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw runerror{"Can't open '" + this->file_name + "'\n"};
+  }
+  FileDescriptor(const FileDescriptor &) = delete;
+  FileDescriptor &operator=(const FileDescriptor &) = delete;
+  ~FileDescriptor() {
+    if (fd >= 0)
+      ::close(fd);
+  }
 
-  FileReaderWide(const string &file_name) : file_name{file_name} {
-    open(this->file_name);
+  int get() const noexcept { return fd; }
+  const string &name() const noexcept { return file_name; }
+
+  void seek(uint64_t offset) const {
+    if (lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0)
+      throw runerror{"Can't seek in '" + file_name + "'\n"};
   }
 
-  FileReaderWide(wistream &stream) { open(stream); }
+  // Function reads up to size bytes and returns 0 at the end of file.
+  size_t read(char *buffer, size_t size) const {
+    ssize_t count{0};
+    do
+      count = ::read(fd, buffer, size);
+    while (count < 0 && errno == EINTR);
 
-  void close() {
-    line.clear();
-    input.release();
+    if (count < 0)
+      throw runerror{"Can't read '" + file_name + "'\n"};
+
+    return static_cast<size_t>(count);
   }
+};
 
-  void open(string_view file_name) {
-    close();
+class BlockSource : public BufferedSource {
+private:
+  FileDescriptor file;
+  AlignedBuffer buffer;
 
-    wifstream file_input;
-    open_file(file_name, file_input);
-    input = std::make_unique<std::wifstream>(std::move(file_input));
+protected:
+  bool fill(string_view &chunk) override {
+    chunk = string_view(buffer.get(), file.read(buffer.get(), buffer.size()));
+    return !chunk.empty();
   }
 
-  void open(wistream &stream) {
-    close();
-    this->input = make_unique<wistream>(stream.rdbuf());
+  void reposition(uint64_t offset) override { file.seek(offset); }
+
+public:
+  BlockSource(string_view file_name, size_t block_size = default_block_size)
+      : file{file_name}, buffer{block_size} {
+    posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
   }
+};
 
-  wstring getLine() const { return line; }
-  long getLineNum() const { return line_num; }
-  wstring str() const { return getLine(); }
-  [[nodiscard]] bool good() const noexcept { return input->good(); }
+// Block source with producer thread reading next block ahead.
+// Two buffers are handed over between producer and consumer through atomic
+// flags only, so parsing of one buffer overlaps with reading the other.
+class ReadAheadSource : public BufferedSource {
+private:
+  struct Slot {
+    AlignedBuffer buffer;
+    size_t size{0};
+    std::atomic<bool> ready{false};
+  };
 
-  friend std::wostream &operator<<(wostream &stream,
-                                   const FileReaderWide &reader) {
-    return stream << reader.str();
+  FileDescriptor file;
+  std::array<Slot, 2> slots;
+  size_t current{0};
+  bool holding{false};
+  std::atomic<bool> stopped{false};
+  std::atomic<bool> failed{false};
+  std::thread producer;
+
+  // Waits until flag reaches state. Short spinning is followed by yielding
+  // and sleeping, so waiting on slow disk does not burn whole core.
+  bool await(const std::atomic<bool> &flag, bool state) const {
+    for (unsigned round = 0; flag.load(std::memory_order_acquire) != state;
+         ++round) {
+      if (stopped.load(std::memory_order_relaxed))
+        return false;
+      if (round < 64)
+        continue;
+      else if (round < 128)
+        std::this_thread::yield();
+      else
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    return true;
+  }
+
+  void produce() {
+    for (size_t index = 0;; index ^= 1) {
+      auto &slot = slots[index];
+      if (!await(slot.ready, false))
+        return;
+
+      try {
+        slot.size = file.read(slot.buffer.get(), slot.buffer.size());
+      } catch (const runerror &) {
+        slot.size = 0;
+        failed.store(true, std::memory_order_relaxed);
+      }
+
+      slot.ready.store(true, std::memory_order_release);
+
+      if (!slot.size)
+        return;
+    }
+  }
+
+protected:
+  bool fill(string_view &chunk) override {
+    if (holding) {
+      slots[current].ready.store(false, std::memory_order_release);
+      current ^= 1;
+    }
+
+    auto &slot = slots[current];
+    await(slot.ready, true);
+    holding = true;
+
+    if (failed.load(std::memory_order_relaxed))
+      throw runerror{"Can't read '" + file.name() + "'\n"};
+
+    chunk = string_view(slot.buffer.get(), slot.size);
+    return slot.size != 0;
+  }
+
+public:
+  ReadAheadSource(string_view file_name,
+                  size_t block_size = default_block_size)
+      : file{file_name}, slots{{{AlignedBuffer{block_size}},
+                                {AlignedBuffer{block_size}}}} {
+    posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    producer = std::thread(&ReadAheadSource::produce, this);
+  }
+  ReadAheadSource(const ReadAheadSource &) = delete;
+  ReadAheadSource &operator=(const ReadAheadSource &) = delete;
+  ~ReadAheadSource() override {
+    stopped.store(true, std::memory_order_relaxed);
+    producer.join();
+  }
+};
+
+class MappedSource : public BufferedSource {
+private:
+  MappedFile file;
+  size_t start{0};
+  bool served{false};
+
+protected:
+  bool fill(string_view &chunk) override {
+    if (served)
+      return false;
+    served = true;
+    chunk = file.view().substr(std::min(start, file.size()));
+    return !chunk.empty();
+  }
+
+  void reposition(uint64_t offset) override {
+    start = static_cast<size_t>(offset);
+    served = false;
+  }
+
+public:
+  MappedSource(string_view file_name) : file{file_name} {}
+};
+
+constexpr size_t default_uring_depth{4};
+
+// Block source keeping depth reads in flight with io_uring, or reading with
+// pread when kernel lacks support. By default sources of one thread share
+// one ring, so reads of many files are queued together.
+class UringSource : public BufferedSource {
+private:
+  struct Slot {
+    AlignedBuffer buffer;
+    Uring::Request request{};
+  };
+
+  FileDescriptor file;
+  std::shared_ptr<Uring::Ring> ring;
+  vector<Slot> slots{};
+  size_t current{0};
+  uint64_t offset{0};
+  bool holding{false};
+  bool finished{false};
+
+  void queue(Slot &slot) {
+    slot.request = {file.get(), slot.buffer.get(), slot.buffer.size(), offset};
+    offset += slot.buffer.size();
+    ring->submit(slot.request);
+  }
+
+  void drain() {
+    for (auto &slot : slots)
+      ring->wait(slot.request);
+  }
+
+  void start() {
+    current = 0;
+    holding = false;
+    finished = false;
+    for (auto &slot : slots)
+      queue(slot);
+  }
+
+protected:
+  bool fill(string_view &chunk) override {
+    if (holding) {
+      if (!finished)
+        queue(slots[current]);
+      current = (current + 1) % slots.size();
+      holding = false;
+    }
+    if (finished)
+      return false;
+
+    auto &request = slots[current].request;
+    ring->wait(request);
+
+    // Failed and short reads are completed synchronously, short read
+    // marks the end of file.
+    auto size = std::max<long>(request.result, 0);
+    if (static_cast<size_t>(size) < request.size) {
+      const auto rest =
+          Uring::read_at(file.get(), request.buffer + size,
+                         request.size - static_cast<size_t>(size),
+                         request.offset + static_cast<uint64_t>(size));
+      if (rest < 0)
+        throw runerror{"Can't read '" + file.name() + "'\n"};
+      size += rest;
+      finished = static_cast<size_t>(size) < request.size;
+    }
+
+    holding = true;
+    chunk = string_view(request.buffer, static_cast<size_t>(size));
+    return size != 0;
+  }
+
+  void reposition(uint64_t offset) override {
+    drain();
+    this->offset = offset;
+    start();
+  }
+
+public:
+  UringSource(string_view file_name, size_t block_size = default_block_size,
+              size_t depth = default_uring_depth,
+              std::shared_ptr<Uring::Ring> ring = Uring::Ring::shared())
+      : file{file_name}, ring{std::move(ring)} {
+    posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    slots.reserve(std::max<size_t>(depth, 1));
+    for (size_t i = 0; i < std::max<size_t>(depth, 1); ++i)
+      slots.push_back({AlignedBuffer{block_size}});
+    start();
+  }
+  UringSource(const UringSource &) = delete;
+  UringSource &operator=(const UringSource &) = delete;
+  ~UringSource() override {
+    try {
+      drain();
+    } catch (const runerror &) {
+    }
+  }
+};
+
+enum class Compression { None, Gzip, Bgzf };
+
+// Function checks gzip magic bytes at the beginning of file. Gzip files
+// carrying BC extra subfield are recognised as BGZF.
+inline Compression detect_compression(string_view file_name) {
+  const FileDescriptor file{file_name};
+
+  unsigned char header[512];
+  const auto count = pread(file.get(), header, sizeof(header), 0);
+  if (count < 2 || header[0] != 0x1f || header[1] != 0x8b)
+    return Compression::None;
+
+  if (count < 12 || !(header[3] & 0x04))
+    return Compression::Gzip;
+
+  const size_t extra_end =
+      std::min<size_t>(12 + (header[10] | header[11] << 8),
+                       static_cast<size_t>(count));
+  for (size_t pos = 12; pos + 4 <= extra_end;
+       pos += 4 + (header[pos + 2] | header[pos + 3] << 8))
+    if (header[pos] == 'B' && header[pos + 1] == 'C')
+      return Compression::Bgzf;
+
+  return Compression::Gzip;
+}
+
+#ifdef AGIZMO_ZLIB
+
+// Line source inflating gzip file, including files with many members.
+class GzipSource : public BufferedSource {
+private:
+  FileDescriptor file;
+  AlignedBuffer input_buffer;
+  AlignedBuffer output_buffer;
+  z_stream stream{};
+  bool member_done{true};
+
+protected:
+  bool fill(string_view &chunk) override {
+    const auto output = reinterpret_cast<Bytef *>(output_buffer.get());
+    stream.next_out = output;
+    stream.avail_out = static_cast<uInt>(output_buffer.size());
+
+    while (stream.next_out == output) {
+      if (!stream.avail_in) {
+        const auto count =
+            file.read(input_buffer.get(), input_buffer.size());
+        if (!count) {
+          if (!member_done)
+            throw runerror{"'" + file.name() + "' is truncated\n"};
+          return false;
+        }
+        stream.next_in = reinterpret_cast<Bytef *>(input_buffer.get());
+        stream.avail_in = static_cast<uInt>(count);
+      }
+
+      if (member_done) {
+        inflateReset(&stream);
+        member_done = false;
+      }
+
+      if (const auto status = inflate(&stream, Z_NO_FLUSH);
+          status == Z_STREAM_END)
+        member_done = true;
+      else if (status != Z_OK && status != Z_BUF_ERROR)
+        throw runerror{"Can't decompress '" + file.name() + "'\n"};
+    }
+
+    chunk = string_view(output_buffer.get(),
+                        static_cast<size_t>(stream.next_out - output));
+    return true;
+  }
+
+public:
+  GzipSource(string_view file_name, size_t block_size = default_block_size)
+      : file{file_name}, input_buffer{block_size}, output_buffer{block_size} {
+    // Window bits 15 + 16 accept only gzip wrapped streams.
+    if (inflateInit2(&stream, 15 + 16) != Z_OK)
+      throw runerror{"Can't initialise zlib for '" + file.name() + "'\n"};
+  }
+  GzipSource(const GzipSource &) = delete;
+  GzipSource &operator=(const GzipSource &) = delete;
+  ~GzipSource() override { inflateEnd(&stream); }
+};
+
+// Function returns number of workers for pool of a nested reader: single one
+// when called by worker of another pool, so readers opened in parallel do not
+// oversubscribe the machine.
+inline size_t nested_workers() noexcept {
+  return Parallel::ThreadPool::inWorker() ? 1 : default_workers();
+}
+
+// Line source for BGZF files (blocked gzip used by htslib).
+// Compressed blocks are independent, so batches of whole blocks are inflated
+// on worker pool and served in file order. Pool is owned by source or shared
+// with caller.
+class BgzfSource : public BufferedSource {
+private:
+  static constexpr size_t header_size{18};
+  static constexpr size_t max_block_size{1 << 16};
+
+  FileDescriptor file;
+  size_t batch_size;
+  string pending{};
+  bool input_done{false};
+  std::unique_ptr<Parallel::ThreadPool> own_pool{nullptr};
+  Parallel::ThreadPool *pool{nullptr};
+  std::deque<std::future<string>> batches{};
+  string current{};
+
+  static uint32_t read_le(const char *data, size_t bytes) noexcept {
+    uint32_t result{0};
+    for (size_t i = bytes; i > 0; --i)
+      result = result << 8 | static_cast<unsigned char>(data[i - 1]);
+    return result;
+  }
+
+  // Function returns size of block starting at data, read from BC subfield.
+  static size_t block_size(const char *data, size_t available,
+                           const string &file_name) {
+    if (static_cast<unsigned char>(data[0]) != 0x1f ||
+        static_cast<unsigned char>(data[1]) != 0x8b || !(data[3] & 0x04))
+      throw runerror{"'" + file_name + "' is not valid BGZF file\n"};
+
+    const size_t extra_end = 12 + read_le(data + 10, 2);
+    for (size_t pos = 12; pos + 6 <= std::min(extra_end, available);
+         pos += 4 + read_le(data + pos + 2, 2))
+      if (data[pos] == 'B' && data[pos + 1] == 'C')
+        return read_le(data + pos + 4, 2) + 1;
+
+    throw runerror{"'" + file_name + "' is not valid BGZF file\n"};
+  }
+
+  static string inflate_blocks(const string &compressed,
+                               const string &file_name) {
+    const auto first = compressed.data();
+    const auto size = compressed.size();
+
+    size_t total{0};
+    for (size_t pos = 0; pos < size;) {
+      const auto length = block_size(first + pos, size - pos, file_name);
+      total += read_le(first + pos + length - 4, 4);
+      pos += length;
+    }
+
+    string result(total, '\0');
+
+    z_stream stream{};
+    if (inflateInit2(&stream, -15) != Z_OK)
+      throw runerror{"Can't initialise zlib for '" + file_name + "'\n"};
+
+    size_t written{0};
+    for (size_t pos = 0; pos < size;) {
+      const auto block = first + pos;
+      const auto length = block_size(block, size - pos, file_name);
+      const auto data_start = 12 + read_le(block + 10, 2);
+      const auto expected = read_le(block + length - 4, 4);
+
+      inflateReset(&stream);
+      stream.next_in =
+          reinterpret_cast<Bytef *>(const_cast<char *>(block + data_start));
+      stream.avail_in = static_cast<uInt>(length - data_start - 8);
+      stream.next_out = reinterpret_cast<Bytef *>(result.data() + written);
+      stream.avail_out = expected;
+
+      const auto status = inflate(&stream, Z_FINISH);
+      const auto checksum =
+          crc32(0, reinterpret_cast<Bytef *>(result.data() + written),
+                expected);
+      if (status != Z_STREAM_END || stream.avail_out ||
+          checksum != read_le(block + length - 8, 4)) {
+        inflateEnd(&stream);
+        throw runerror{"Can't decompress '" + file_name + "'\n"};
+      }
+
+      written += expected;
+      pos += length;
+    }
+
+    inflateEnd(&stream);
+    return result;
+  }
+
+  // Function reads next portion of file and submits whole blocks found in
+  // it for decompression. It returns false when input is exhausted.
+  bool dispatch() {
+    if (input_done)
+      return false;
+
+    size_t whole{0};
+    while (!whole) {
+      const auto offset = pending.size();
+      pending.resize(offset + batch_size);
+      pending.resize(offset + file.read(pending.data() + offset, batch_size));
+
+      for (size_t pos = 0; pos + header_size <= pending.size();) {
+        const auto length =
+            block_size(pending.data() + pos, pending.size() - pos, file.name());
+        if (pos + length > pending.size())
+          break;
+        whole = pos += length;
+      }
+
+      if (pending.size() == offset) {
+        if (whole)
+          break;
+        if (!pending.empty())
+          throw runerror{"'" + file.name() + "' is truncated\n"};
+        input_done = true;
+        return false;
+      }
+    }
+
+    batches.push_back(pool->submit(
+        [compressed = pending.substr(0, whole), &name = file.name()]() {
+          return inflate_blocks(compressed, name);
+        }));
+    pending.erase(0, whole);
+
+    return true;
+  }
+
+protected:
+  bool fill(string_view &chunk) override {
+    while (true) {
+      while (batches.size() < 2 * pool->size() && dispatch())
+        continue;
+
+      if (batches.empty())
+        return false;
+
+      current = batches.front().get();
+      batches.pop_front();
+
+      if (!current.empty()) {
+        chunk = current;
+        return true;
+      }
+    }
   }
 
-  //  bool readLine(const string &skip = {}) {
-  //    if (skip.empty()) {
-  //      getline(*input, line);
-  //      ++line_num;
-  //    } else {
-  //      while (getline(*input, line) && line.find_first_of(skip) == 0) {
-  //        ++line_num;
-  //        continue;
-  //      }
-  //      ++line_num;
-  //    }
-
-  //    return good();
-  //  }
-
-  //  bool readLine(const int skip) {
-  //    if (!skip)
-  //      readLine();
-  //    else {
-  //      for (int i = 0; i < skip; ++i) {
-  //        getline(*input, line);
-  //        if (!input)
-  //          break;
-  //      }
-  //      line_num += skip;
-  //    }
-
-  //    return good();
-  //  }
-
-  //  bool readLineInto(string &external, const string &skip = {}) {
-  //    if (skip.empty())
-  //      getline(*input, external);
-  //    else
-  //      while (getline(*input, external) && external.find_first_of(skip) == 0)
-  //        continue;
-  //    return good();
-  //  }
-
-  //  bool readLineInto(string &external, int skip) {
-  //    for (int i = 0; i < skip; ++i) {
-  //      getline(*input, external);
-  //      if (!input)
-  //        break;
-  //    }
-  //    return good();
-  //  }
-
-  //  opt_str operator()(const string &skip = {}) {
-  //    if (readLine(skip))
-  //      return line;
-  //    else
-  //      return nullopt;
-  //  }
-
-  //  opt_str operator()(const int skip) {
-  //    if (readLine(skip))
-  //      return line;
-  //    else
-  //      return nullopt;
-  //  }
-
-  //  bool setLineToMatch(const string &match) {
-  //    do {
-  //      getline(*input, line);
-  //      if (line == match)
-  //        return true;
-  //    } while (good());
-
-  //    return false;
-  //  }
+public:
+  BgzfSource(string_view file_name, size_t block_size = default_block_size,
+             size_t workers = nested_workers())
+      : file{file_name}, batch_size{std::max(block_size, max_block_size)},
+        own_pool{make_unique<Parallel::ThreadPool>(workers)},
+        pool{own_pool.get()} {
+    posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  // Reading waits for tasks submitted to pool, so it must not be the pool
+  // whose worker reads the source.
+  BgzfSource(string_view file_name, Parallel::ThreadPool &pool,
+             size_t block_size = default_block_size)
+      : file{file_name}, batch_size{std::max(block_size, max_block_size)},
+        pool{&pool} {
+    posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+  // Remaining batches have to finish before buffers they use are released.
+  ~BgzfSource() override {
+    for (auto &batch : batches)
+      batch.wait();
+  }
+
+  size_t getWorkers() const noexcept { return pool->size(); }
 };
 
+inline unique_ptr<LineSource> open_compressed(string_view file_name,
+                                              Compression compression,
+                                              size_t block_size) {
+  if (compression == Compression::Bgzf)
+    return make_unique<BgzfSource>(file_name, block_size);
+  else
+    return make_unique<GzipSource>(file_name, block_size);
+}
+
+#else
+
+inline unique_ptr<LineSource> open_compressed(string_view file_name,
+                                              Compression, size_t) {
+  throw runerror{"'" + string(file_name) +
+                 "' is compressed, but AGizmo was built without zlib\n"};
+}
+
+#endif
+
+class LineIndex;
+
 class FileReader {
 private:
-  std::unique_ptr<std::istream> input{nullptr};
+  std::unique_ptr<LineSource> input{nullptr};
+  std::shared_ptr<const LineIndex> index{nullptr};
   string file_name{};
-  string line{};
+  string_view line{};
   int line_num{0};
 
+  static bool starts_with_any(string_view line, const string &skip) noexcept {
+    return !line.empty() && skip.find(line.front()) != string::npos;
+  }
+
 public:
   FileReader() = delete;
 
-  FileReader(const string &file_name) : file_name{file_name} {
-    open(this->file_name);
+  FileReader(const string &file_name, ReadMode mode = ReadMode::Block,
+             size_t block_size = default_block_size)
+      : file_name{file_name} {
+    open(this->file_name, mode, block_size);
   }
 
   FileReader(istream &stream) { open(stream); }
 
+  // Reader of custom source, e.g. UringSource sharing given ring.
+  FileReader(unique_ptr<LineSource> source) { open(std::move(source)); }
+
   ~FileReader() { close(); }
 
   void close() {
-    line = "";
-    input.release();
+    line = {};
+    line_num = 0;
+    input.reset();
+    index.reset();
   }
-  void open(string_view file_name) {
+
+  // Gzip and BGZF compressed files are detected by their magic bytes and
+  // decompressed transparently, regardless of mode.
+  void open(string_view file_name, ReadMode mode = ReadMode::Block,
+            size_t block_size = default_block_size) {
     close();
+    this->file_name = string(file_name);
+    file_name = this->file_name;
+
+    if (const auto compression = detect_compression(file_name);
+        compression != Compression::None) {
+      input = open_compressed(file_name, compression, block_size);
+      return;
+    }
 
-    ifstream file_input;
-    open_file(file_name, file_input);
-    input = std::make_unique<std::ifstream>(std::move(file_input));
+    switch (mode) {
+    case ReadMode::Block:
+      input = make_unique<BlockSource>(file_name, block_size);
+      break;
+    case ReadMode::ReadAhead:
+      input = make_unique<ReadAheadSource>(file_name, block_size);
+      break;
+    case ReadMode::Mapped:
+      input = make_unique<MappedSource>(file_name);
+      break;
+    case ReadMode::Uring:
+      input = make_unique<UringSource>(file_name, block_size);
+      break;
+    default:
+      ifstream file_input;
+      open_file(file_name, file_input);
+      input = make_unique<StreamSource>(
+          make_unique<ifstream>(std::move(file_input)));
+      break;
+    }
   }
 
   void open(istream &stream) {
     close();
-    this->input = make_unique<istream>(stream.rdbuf());
+    input = make_unique<StreamSource>(make_unique<istream>(stream.rdbuf()));
+  }
+
+  void open(unique_ptr<LineSource> source) {
+    close();
+    input = std::move(source);
   }
 
-  string getLine() const { return line; }
+  string getLine() const { return string(line); }
+  // Returned view is invalidated by the next read.
+  string_view getLineView() const noexcept { return line; }
   int getLineNum() const { return line_num; }
   string str() const { return getLine(); }
   [[nodiscard]] bool good() const noexcept { return input->good(); }
 
   friend std::ostream &operator<<(ostream &stream, const FileReader &reader) {
-    return stream << reader.str();
+    return stream << reader.getLineView();
   }
 
   bool readLine(const string &skip = {}) {
     if (skip.empty()) {
-      getline(*input, line);
+      input->next(line);
       ++line_num;
     } else {
-      while (getline(*input, line) && line.find_first_of(skip) == 0) {
+      while (input->next(line) && starts_with_any(line, skip)) {
         ++line_num;
         continue;
       }
@@ -216,13 +950,24 @@ public:
     return good();
   }
 
+  // Function works like readLine, but returns true whenever line was
+  // extracted, including last line not terminated with newline.
+  bool nextLine(const string &skip = {}) {
+    bool extracted{false};
+    while ((extracted = input->next(line)) && !skip.empty() &&
+           starts_with_any(line, skip))
+      ++line_num;
+    ++line_num;
+
+    return extracted;
+  }
+
   bool readLine(const int skip) {
     if (!skip)
       readLine();
     else {
       for (int i = 0; i < skip; ++i) {
-        getline(*input, line);
-        if (!input)
+        if (!input->next(line))
           break;
       }
       line_num += skip;
@@ -233,45 +978,1242 @@ public:
 
   bool readLineInto(string &external, const string &skip = {}) {
     if (skip.empty())
-      getline(*input, external);
+      input->next(line);
     else
-      while (getline(*input, external) && external.find_first_of(skip) == 0)
+      while (input->next(line) && starts_with_any(line, skip))
         continue;
+    external.assign(line);
     return good();
   }
 
   bool readLineInto(string &external, int skip) {
     for (int i = 0; i < skip; ++i) {
-      getline(*input, external);
-      if (!input)
+      if (!input->next(line))
         break;
     }
+    if (skip > 0)
+      external.assign(line);
     return good();
   }
 
   opt_str operator()(const string &skip = {}) {
     if (readLine(skip))
-      return line;
+      return getLine();
     else
       return nullopt;
   }
 
   opt_str operator()(const int skip) {
     if (readLine(skip))
-      return line;
+      return getLine();
     else
       return nullopt;
   }
 
   bool setLineToMatch(const string &match) {
     do {
-      getline(*input, line);
+      input->next(line);
       if (line == match)
         return true;
     } while (good());
 
     return false;
   }
+
+  // Index is shared, so many readers of the same file can use it.
+  void setIndex(std::shared_ptr<const LineIndex> index) noexcept {
+    this->index = std::move(index);
+  }
+
+  // Function reads line number line_num, like readLine(line_num) on freshly
+  // opened file, but jumps close to the line with LineIndex. Index is loaded
+  // from sidecar file or built when it is missing or stale, also when index
+  // in use becomes stale.
+  bool seekLine(long line_num);
 };
 
+// Reader of UTF-8 encoded text returning lines as wide strings. Lines are
+// read as bytes with FileReader, lines holding only ASCII characters are just
+// widened, others are validated and decoded. Invalid UTF-8 throws runerror.
+class FileReaderWide {
+private:
+  FileReader bytes;
+  string file_name{};
+  wstring line{};
+
+  template <class Char>
+  void decode(std::basic_string<Char> &target) const {
+    const auto view = bytes.getLineView();
+    const auto first = view.data();
+    const auto last = first + view.size();
+
+    if (!Simd::is_ascii(first, last) && !Simd::validate_utf8(first, last))
+      throw runerror{"Invalid UTF-8 in line " +
+                     std::to_string(bytes.getLineNum()) +
+                     (file_name.empty() ? "" : " of '" + file_name + "'") +
+                     "\n"};
+
+    target.resize(view.size());
+    target.resize(static_cast<size_t>(
+        Simd::decode_utf8(first, last, target.data()) - target.data()));
+  }
+
+public:
+  FileReaderWide() = delete;
+
+  FileReaderWide(const string &file_name, ReadMode mode = ReadMode::Block,
+                 size_t block_size = default_block_size)
+      : bytes{file_name, mode, block_size}, file_name{file_name} {}
+
+  FileReaderWide(istream &stream) : bytes{stream} {}
+
+  void close() {
+    line.clear();
+    bytes.close();
+  }
+
+  void open(string_view file_name, ReadMode mode = ReadMode::Block,
+            size_t block_size = default_block_size) {
+    close();
+    this->file_name = string(file_name);
+    bytes.open(this->file_name, mode, block_size);
+  }
+
+  void open(istream &stream) {
+    close();
+    file_name.clear();
+    bytes.open(stream);
+  }
+
+  wstring getLine() const { return line; }
+  // Current line decoded to UTF-32, independent of the size of wchar_t.
+  std::u32string getLineU32() const {
+    std::u32string result;
+    decode(result);
+    return result;
+  }
+  long getLineNum() const { return bytes.getLineNum(); }
+  wstring str() const { return getLine(); }
+  [[nodiscard]] bool good() const noexcept { return bytes.good(); }
+
+  friend std::wostream &operator<<(wostream &stream,
+                                   const FileReaderWide &reader) {
+    return stream << reader.str();
+  }
+
+  bool readLine(const string &skip = {}) {
+    const auto result = bytes.readLine(skip);
+    decode(line);
+    return result;
+  }
+
+  bool readLine(const int skip) {
+    const auto result = bytes.readLine(skip);
+    decode(line);
+    return result;
+  }
+
+  bool readLineInto(wstring &external, const string &skip = {}) {
+    const auto result = bytes.readLine(skip);
+    decode(external);
+    return result;
+  }
+
+  bool readLineInto(wstring &external, int skip) {
+    if (skip <= 0)
+      return good();
+    const auto result = bytes.readLine(skip);
+    decode(external);
+    return result;
+  }
+
+  std::optional<wstring> operator()(const string &skip = {}) {
+    if (readLine(skip))
+      return line;
+    else
+      return nullopt;
+  }
+
+  std::optional<wstring> operator()(const int skip) {
+    if (readLine(skip))
+      return line;
+    else
+      return nullopt;
+  }
+
+  bool setLineToMatch(const wstring &match) {
+    do {
+      readLine();
+      if (line == match)
+        return true;
+    } while (good());
+
+    return false;
+  }
+};
+
+// Fields of single delimited record viewed in the buffer of reader.
+// Views are valid until the next record is read.
+class Record {
+private:
+  vector<string_view> fields{};
+
+  friend class RecordReader;
+  friend class CsvReader;
+
+public:
+  size_t size() const noexcept { return fields.size(); }
+  bool empty() const noexcept { return fields.empty(); }
+  auto begin() const noexcept { return fields.begin(); }
+  auto end() const noexcept { return fields.end(); }
+
+  string_view operator[](size_t index) const noexcept { return fields[index]; }
+
+  string_view at(size_t index) const {
+    if (index >= fields.size())
+      throw runerror{"Field " + std::to_string(index) + " is out of range (" +
+                     std::to_string(fields.size()) + " fields)\n"};
+    return fields[index];
+  }
+
+  string str(size_t index) const { return string(at(index)); }
+
+  // Function converts field to Type. Numbers are parsed with from_chars and
+  // have to span whole field, otherwise nullopt is returned.
+  template <class Type> std::optional<Type> get(size_t index) const {
+    const auto field = at(index);
+
+    if constexpr (std::is_same_v<Type, string_view>)
+      return field;
+    else if constexpr (std::is_same_v<Type, string>)
+      return string(field);
+    else {
+      static_assert(std::is_arithmetic_v<Type>,
+                    "Record::get supports strings and numbers only");
+      Type result{};
+      const auto last = field.data() + field.size();
+      const auto [pos, error] = std::from_chars(field.data(), last, result);
+      if (error != std::errc{} || pos != last)
+        return nullopt;
+      return result;
+    }
+  }
+
+  template <class Type> Type get(size_t index, Type backup) const {
+    return get<Type>(index).value_or(backup);
+  }
+};
+
+// Reader of delimited records fusing FileReader with field splitting.
+// Single Record is reused, so in the steady state reading a record does not
+// allocate memory. With projection set, records hold only selected columns
+// and scanning of each line stops at the last of them.
+class RecordReader {
+private:
+  FileReader reader;
+  Record record{};
+  char sep;
+  vector<size_t> columns{};
+  vector<std::pair<size_t, size_t>> order{};
+
+  void split(string_view line) {
+    auto &fields = record.fields;
+    fields.clear();
+
+    const auto last = line.data() + line.size();
+    for (auto pos = line.data();;) {
+      const auto found = Simd::find_byte(pos, last, sep);
+      fields.emplace_back(pos, static_cast<size_t>(found - pos));
+      if (found == last)
+        break;
+      pos = found + 1;
+    }
+  }
+
+  // Fields missing in short lines are left empty.
+  void split_projected(string_view line) {
+    auto &fields = record.fields;
+    fields.assign(columns.size(), string_view{});
+
+    const auto last = line.data() + line.size();
+    auto pos = line.data();
+    auto found = Simd::find_byte(pos, last, sep);
+    size_t column{0};
+
+    for (const auto &[wanted, slot] : order) {
+      for (; column < wanted; ++column) {
+        if (found == last)
+          return;
+        pos = found + 1;
+        found = Simd::find_byte(pos, last, sep);
+      }
+      fields[slot] = string_view(pos, static_cast<size_t>(found - pos));
+    }
+  }
+
+public:
+  RecordReader() = delete;
+  RecordReader(const string &file_name, char sep = '\t',
+               ReadMode mode = ReadMode::Block)
+      : reader{file_name, mode}, sep{sep} {}
+  RecordReader(istream &stream, char sep = '\t') : reader{stream}, sep{sep} {}
+
+  // Function reads next record, lines starting with any character from skip
+  // are omitted. It returns false when no line was left.
+  bool readRecord(const string &skip = {}) {
+    if (!reader.nextLine(skip)) {
+      record.fields.clear();
+      return false;
+    }
+    if (columns.empty())
+      split(reader.getLineView());
+    else
+      split_projected(reader.getLineView());
+    return true;
+  }
+
+  // Function limits records to given columns, in given order.
+  // Empty list restores reading of all fields.
+  void project(vector<size_t> columns) {
+    this->columns = std::move(columns);
+    order.clear();
+    for (size_t slot = 0; slot < this->columns.size(); ++slot)
+      order.emplace_back(this->columns[slot], slot);
+    std::sort(order.begin(), order.end());
+  }
+
+  // Function reads header line and limits records to columns with given
+  // names. It throws when any name is missing in the header.
+  void project(const vector<string> &names, const string &skip = {}) {
+    project(vector<size_t>{});
+    if (!readRecord(skip))
+      throw runerror{"Header is missing\n"};
+
+    vector<size_t> found{};
+    found.reserve(names.size());
+    for (const auto &name : names) {
+      const auto column = std::find(record.begin(), record.end(), name);
+      if (column == record.end())
+        throw runerror{"Column '" + name + "' is missing in header\n"};
+      found.push_back(static_cast<size_t>(column - record.begin()));
+    }
+
+    project(std::move(found));
+  }
+
+  const vector<size_t> &getColumns() const noexcept { return columns; }
+
+  const Record &getRecord() const noexcept { return record; }
+  const FileReader &getReader() const noexcept { return reader; }
+  FileReader &getReader() noexcept { return reader; }
+  int getLineNum() const { return reader.getLineNum(); }
+};
+
+// Reader of RFC 4180 CSV records on top of FileReader. Quoted fields may
+// hold separators, line breaks and doubled quotes. Fields view line in
+// reader's buffer, lines are copied only when quoted field spans several of
+// them and fields holding doubled quotes are unescaped into scratch space.
+// Quotes are recognised only at the start of fields and quoted field ends at
+// its closing quote, other quotes are kept as text. Separators and quotes
+// are searched with Simd::find_byte, so records without quoted fields are
+// split as fast as by RecordReader. Trailing carriage return of record is
+// dropped.
+class CsvReader {
+private:
+  FileReader reader;
+  Record record{};
+  char sep;
+  char quote;
+  string joined{};
+  string unescaped{};
+  vector<std::pair<size_t, size_t>> bounds{};
+
+  // Function strips quotes of field and unescapes doubled ones. Unescaped
+  // text is appended to scratch reserved for whole record, so earlier views
+  // stay valid.
+  string_view unquote(string_view field) {
+    if (field.size() < 2 || field.front() != quote || field.back() != quote)
+      return field;
+    field = field.substr(1, field.size() - 2);
+
+    auto found = field.find(quote);
+    if (found == string_view::npos)
+      return field;
+
+    const auto start = unescaped.size();
+    size_t pos{0};
+    for (; found != string_view::npos; found = field.find(quote, pos)) {
+      // Quote is kept and the next one, which it escapes, skipped.
+      unescaped.append(field.data() + pos, found + 1 - pos);
+      pos = found + 1;
+      if (pos < field.size() && field[pos] == quote)
+        ++pos;
+    }
+    unescaped.append(field.data() + pos, field.size() - pos);
+    return string_view(unescaped.data() + start, unescaped.size() - start);
+  }
+
+  // Function returns position after closing quote searched from pos,
+  // skipping doubled quotes, or nullptr when quotation is not closed.
+  const char *find_closing(const char *pos, const char *last) const noexcept {
+    for (;; pos += 2) {
+      pos = Simd::find_byte(pos, last, quote);
+      if (pos == last)
+        return nullptr;
+      if (std::next(pos) == last || pos[1] != quote)
+        return std::next(pos);
+    }
+  }
+
+  static string_view strip(string_view text) noexcept {
+    if (!text.empty() && text.back() == '\r')
+      text.remove_suffix(1);
+    return text;
+  }
+
+  // Function appends bounds of fields of text, starting with field at start.
+  // It returns false if quotation is left open at the end of text, then
+  // start is kept and resume set past scanned text, so only lines appended
+  // later are scanned on the next call.
+  bool scan(string_view text, size_t &start, size_t &resume) {
+    const auto first = text.data();
+    const auto last = first + text.size();
+    for (;;) {
+      auto found = first + start;
+      if (found != last && *found == quote) {
+        found = find_closing(first + std::max(start + 1, resume), last);
+        if (!found) {
+          resume = text.size();
+          return false;
+        }
+      }
+      found = Simd::find_byte(found, last, sep);
+      const auto end = static_cast<size_t>(found - first);
+      bounds.emplace_back(start, end);
+      if (found == last)
+        return true;
+      start = end + 1;
+    }
+  }
+
+  // Function turns bounds into fields of record viewing text.
+  void store(string_view text) {
+    auto &fields = record.fields;
+    fields.clear();
+    unescaped.clear();
+
+    for (const auto &[start, end] : bounds) {
+      const auto field = text.substr(start, end - start);
+      // Reserved once for whole record, so views into scratch stay valid.
+      if (!field.empty() && field.front() == quote)
+        unescaped.reserve(text.size());
+      fields.push_back(unquote(field));
+    }
+  }
+
+public:
+  CsvReader() = delete;
+  CsvReader(const string &file_name, char sep = ',', char quote = '"',
+            ReadMode mode = ReadMode::Block)
+      : reader{file_name, mode}, sep{sep}, quote{quote} {}
+  CsvReader(istream &stream, char sep = ',', char quote = '"')
+      : reader{stream}, sep{sep}, quote{quote} {}
+
+  // Function reads next record, joining lines while quoted field is open.
+  // Each line is scanned once, so records spanning many lines are read in
+  // linear time. It returns false when no line was left and throws when
+  // quotation is not closed before the end of file.
+  bool readRecord() {
+    if (!reader.nextLine()) {
+      record.fields.clear();
+      return false;
+    }
+
+    bounds.clear();
+    size_t start{0}, resume{0};
+    const auto line = reader.getLineView();
+    if (scan(strip(line), start, resume)) {
+      store(line);
+      return true;
+    }
+
+    const auto first = reader.getLineNum();
+    joined.assign(line);
+    do {
+      if (!reader.nextLine())
+        throw runerror{"Unclosed quotation in record starting in line " +
+                       std::to_string(first) + "\n"};
+      joined += '\n';
+      joined += reader.getLineView();
+    } while (!scan(strip(joined), start, resume));
+
+    store(joined);
+    return true;
+  }
+
+  const Record &getRecord() const noexcept { return record; }
+  const FileReader &getReader() const noexcept { return reader; }
+  FileReader &getReader() noexcept { return reader; }
+  int getLineNum() const { return reader.getLineNum(); }
+};
+
+// Buffered writer, output counterpart of FileReader.
+// Data is collected in user sized buffer and written with write(2) (or
+// passed to stream buffer) only when buffer is full or flush is called.
+// Numbers are formatted with to_chars.
+class FileWriter {
+private:
+  // Buffer is rounded up only to cache line, so small sizes are honoured.
+  static constexpr size_t buffer_alignment{64};
+
+  int fd{-1};
+  std::streambuf *output{nullptr};
+  string file_name{};
+  AlignedBuffer buffer;
+  size_t used{0};
+  bool line_start{true};
+
+  void put(const char *data, size_t size) {
+    if (output) {
+      if (output->sputn(data, static_cast<std::streamsize>(size)) !=
+          static_cast<std::streamsize>(size))
+        throw runerror{"Can't write to stream\n"};
+      return;
+    }
+
+    while (size) {
+      const auto count = ::write(fd, data, size);
+      if (count < 0 && errno == EINTR)
+        continue;
+      if (count < 0)
+        throw runerror{"Can't write '" + file_name + "'\n"};
+      data += count;
+      size -= static_cast<size_t>(count);
+    }
+  }
+
+  // Function makes room for at least size bytes and returns false when data
+  // is too big to be buffered at all.
+  bool reserve(size_t size) {
+    if (used + size <= buffer.size())
+      return true;
+    flush();
+    return size <= buffer.size();
+  }
+
+  // Function formats number of at most size characters straight into
+  // buffer, or into temporary string when size exceeds buffer.
+  template <class... Args> FileWriter &format(size_t size, Args... args) {
+    if (reserve(size)) {
+      const auto first = buffer.get() + used;
+      const auto [last, error] = std::to_chars(first, first + size, args...);
+      if (error != std::errc{})
+        throw runerror{"Can't format number\n"};
+      used += static_cast<size_t>(last - first);
+      line_start = false;
+      return *this;
+    }
+
+    string temp(size, '\0');
+    const auto [last, error] =
+        std::to_chars(temp.data(), temp.data() + size, args...);
+    if (error != std::errc{})
+      throw runerror{"Can't format number\n"};
+    temp.resize(static_cast<size_t>(last - temp.data()));
+    return write(temp);
+  }
+
+public:
+  FileWriter() = delete;
+  FileWriter(const string &file_name, size_t buffer_size = default_block_size,
+             bool append = false)
+      : file_name{file_name}, buffer{buffer_size, buffer_alignment} {
+    fd = ::open(this->file_name.c_str(),
+                O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+    if (fd < 0)
+      throw runerror{"Can't open '" + this->file_name + "'\n"};
+  }
+  FileWriter(ostream &stream, size_t buffer_size = default_block_size)
+      : output{stream.rdbuf()}, buffer{buffer_size, buffer_alignment} {}
+  FileWriter(const FileWriter &) = delete;
+  FileWriter &operator=(const FileWriter &) = delete;
+
+  ~FileWriter() {
+    try {
+      close();
+    } catch (const runerror &ex) {
+      std::cerr << ex.what();
+    }
+  }
+
+  void flush() {
+    if (used)
+      put(buffer.get(), used);
+    used = 0;
+    if (output)
+      output->pubsync();
+  }
+
+  void close() {
+    flush();
+    if (fd >= 0)
+      ::close(fd);
+    fd = -1;
+    output = nullptr;
+  }
+
+  FileWriter &write(string_view data) {
+    if (reserve(data.size())) {
+      std::memcpy(buffer.get() + used, data.data(), data.size());
+      used += data.size();
+    } else
+      put(data.data(), data.size());
+    if (!data.empty())
+      line_start = data.back() == '\n';
+    return *this;
+  }
+
+  FileWriter &write(const char *data) { return write(string_view(data)); }
+  FileWriter &write(const string &data) { return write(string_view(data)); }
+
+  FileWriter &write(char data) {
+    reserve(1);
+    buffer.get()[used++] = data;
+    line_start = data == '\n';
+    return *this;
+  }
+
+  template <class Type>
+  std::enable_if_t<std::is_integral_v<Type> && !std::is_same_v<Type, char> &&
+                       !std::is_same_v<Type, bool>,
+                   FileWriter &>
+  write(Type value) {
+    return format(std::numeric_limits<Type>::digits10 + 3, value);
+  }
+
+  FileWriter &write(bool value) { return write(value ? '1' : '0'); }
+
+  // Shortest representation that reads back to the same value.
+  FileWriter &write(double value) { return format(32, value); }
+
+  // Fixed notation of large numbers takes up to max_exponent10 digits before
+  // point, negative precision means 6.
+  FileWriter &write(double value, std::chars_format style, int precision) {
+    const auto size =
+        static_cast<size_t>(std::numeric_limits<double>::max_exponent10 +
+                            std::max(precision, 6) + 8);
+    return format(size, value, style, precision);
+  }
+
+  FileWriter &endLine() { return write('\n'); }
+
+  // Function writes value preceded by separator, unless it is the first
+  // field in line.
+  template <class Type> FileWriter &writeField(const Type &value, char sep) {
+    if (!line_start)
+      write(sep);
+    return write(value);
+  }
+
+  // Function writes values separated with sep and terminates line.
+  template <class... Types>
+  FileWriter &writeRecord(char sep, const Types &...values) {
+    line_start = true;
+    (writeField(values, sep), ...);
+    return endLine();
+  }
+
+  template <class It, class = std::enable_if_t<!std::is_arithmetic_v<It>>>
+  FileWriter &writeRecord(It first, It last, char sep) {
+    line_start = true;
+    for (; first != last; ++first)
+      writeField(*first, sep);
+    return endLine();
+  }
+
+  template <class Type> FileWriter &operator<<(const Type &value) {
+    return write(value);
+  }
+};
+
+// Part of a file holding only whole lines.
+// Iterating over range yields lines (without newlines) as views. Line numbers
+// are global when first line of range is known, otherwise they are counted
+// from the beginning of the range.
+class LineRange {
+private:
+  const char *first{nullptr};
+  const char *last{nullptr};
+  long first_line{0};
+
+public:
+  class iterator {
+  private:
+    const char *pos{nullptr};
+    const char *last{nullptr};
+    string_view line{};
+    long line_num{0};
+
+    void extract() noexcept {
+      if (pos == last)
+        return;
+      const auto found = Simd::find_byte(pos, last, '\n');
+      line = string_view(pos, static_cast<size_t>(found - pos));
+    }
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const string_view *;
+    using reference = const string_view &;
+
+    iterator() = default;
+    iterator(const char *pos, const char *last, long line_num) noexcept
+        : pos{pos}, last{last}, line_num{line_num} {
+      extract();
+    }
+
+    reference operator*() const noexcept { return line; }
+    pointer operator->() const noexcept { return &line; }
+
+    iterator &operator++() noexcept {
+      pos = line.data() + line.size() + (line.data() + line.size() != last);
+      ++line_num;
+      extract();
+      return *this;
+    }
+
+    iterator operator++(int) noexcept {
+      auto result = *this;
+      ++*this;
+      return result;
+    }
+
+    long getLineNum() const noexcept { return line_num; }
+
+    bool operator==(const iterator &other) const noexcept {
+      return pos == other.pos;
+    }
+    bool operator!=(const iterator &other) const noexcept {
+      return !(*this == other);
+    }
+  };
+
+  LineRange() = default;
+  LineRange(const char *first, const char *last, long first_line = 0) noexcept
+      : first{first}, last{last}, first_line{first_line} {}
+
+  iterator begin() const noexcept {
+    return {first, last, first_line ? first_line : 1};
+  }
+  iterator end() const noexcept { return {last, last, 0}; }
+
+  string_view view() const noexcept {
+    return {first, static_cast<size_t>(last - first)};
+  }
+  size_t size() const noexcept { return static_cast<size_t>(last - first); }
+  bool empty() const noexcept { return first == last; }
+
+  bool isNumbered() const noexcept { return first_line != 0; }
+  long getFirstLine() const noexcept { return first_line; }
+  void setFirstLine(long line_num) noexcept { first_line = line_num; }
+
+  // Function returns number of lines in range, including last line not
+  // terminated with newline.
+  long countLines() const noexcept {
+    if (empty())
+      return 0;
+    return static_cast<long>(Simd::count_byte(first, last, '\n')) +
+           (*std::prev(last) != '\n');
+  }
+};
+
+// Function splits data into at most parts ranges of similar size.
+// Boundaries are moved forward to the nearest line start, so every line
+// belongs to exactly one range. Empty ranges are skipped.
+inline vector<LineRange> split_lines(string_view data, size_t parts) {
+  vector<LineRange> result{};
+
+  const auto first = data.data();
+  const auto last = first + data.size();
+  const auto size = data.size();
+
+  result.reserve(std::max<size_t>(parts, 1));
+
+  auto start = first;
+  for (size_t i = 1; i < parts && start != last; ++i) {
+    auto stop = first + size * i / parts;
+    if (stop <= start)
+      continue;
+    if (*std::prev(stop) != '\n') {
+      stop = Simd::find_byte(stop, last, '\n');
+      if (stop != last)
+        ++stop;
+    }
+    result.emplace_back(start, stop);
+    start = stop;
+  }
+
+  if (start != last)
+    result.emplace_back(start, last);
+
+  return result;
+}
+
+// Function calls func for every element of items, each on separate thread.
+// Calling thread handles first item. Exceptions are rethrown after all
+// threads finished.
+template <class Type, class Func>
+vector<std::invoke_result_t<Func &, Type &>> run_parallel(vector<Type> &items,
+                                                          Func func) {
+  using Result = std::invoke_result_t<Func &, Type &>;
+
+  if (items.empty())
+    return {};
+
+  vector<std::future<Result>> futures{};
+  futures.reserve(items.size() - 1);
+  for (auto item = std::next(items.begin()); item != items.end(); ++item)
+    futures.push_back(std::async(std::launch::async,
+                                 [&func, item]() { return func(*item); }));
+
+  vector<Result> result{};
+  result.reserve(items.size());
+  result.push_back(func(items.front()));
+
+  for (auto &future : futures)
+    future.wait();
+  for (auto &future : futures)
+    result.push_back(future.get());
+
+  return result;
+}
+
+// Parallel driver processing single file split into byte ranges.
+// File is mapped once and every worker iterates over lines of its own range.
+// Results of workers are merged in file order with user provided reduce.
+class ParallelReader {
+private:
+  MappedFile file;
+  vector<LineRange> ranges{};
+  long lines{0};
+
+public:
+  ParallelReader() = delete;
+  ParallelReader(string_view file_name, size_t workers = default_workers(),
+                 bool number_lines = false)
+      : file{file_name}, ranges{split_lines(file.view(), workers)} {
+    if (number_lines)
+      numberLines();
+  }
+
+  const vector<LineRange> &getRanges() const noexcept { return ranges; }
+  size_t size() const noexcept { return ranges.size(); }
+  string_view view() const noexcept { return file.view(); }
+  // Total number of lines, known after numberLines.
+  long getLines() const noexcept { return lines; }
+
+  // Function counts lines of every range in parallel and uses prefix sum of
+  // these counts to assign global line numbers.
+  void numberLines() {
+    const auto counts = run_parallel(
+        ranges, [](LineRange &range) { return range.countLines(); });
+
+    long first_line{1};
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      ranges[i].setFirstLine(first_line);
+      first_line += counts[i];
+    }
+    lines = first_line - 1;
+  }
+
+  // Function calls map(const LineRange &) for every range on separate thread
+  // and folds returned values with reduce(Type, Result) in file order.
+  template <class Type, class Map, class Reduce>
+  Type reduce(Type init, Map map, Reduce reduce) {
+    auto results = run_parallel(
+        ranges, [&map](const LineRange &range) { return map(range); });
+
+    for (auto &ele : results)
+      init = reduce(std::move(init), std::move(ele));
+
+    return init;
+  }
+};
+
+// Function maps lines of file in parallel and reduces results.
+template <class Type, class Map, class Reduce>
+Type map_reduce_lines(string_view file_name, Type init, Map map, Reduce reduce,
+                      size_t workers = default_workers(),
+                      bool number_lines = false) {
+  return ParallelReader(file_name, workers, number_lines)
+      .reduce(std::move(init), map, reduce);
+}
+
+// Function returns paths matching shell wildcard pattern, sorted.
+inline vector<string> glob_files(const string &pattern) {
+  glob_t found{};
+  const auto status = ::glob(pattern.c_str(), 0, nullptr, &found);
+  if (status != 0 && status != GLOB_NOMATCH) {
+    globfree(&found);
+    throw runerror{"Can't expand '" + pattern + "'\n"};
+  }
+
+  vector<string> result(found.gl_pathv, found.gl_pathv + found.gl_pathc);
+  globfree(&found);
+  return result;
+}
+
+// Totals gathered by MultiFileReader while reading, bytes count line
+// contents with newlines after decompression.
+struct ReadSummary {
+  size_t files{0};
+  size_t shards{0};
+  size_t lines{0};
+  size_t bytes{0};
+  double seconds{0.0};
+
+  double megabytesPerSecond() const noexcept {
+    return seconds > 0.0 ? static_cast<double>(bytes) / 1e6 / seconds : 0.0;
+  }
+
+  string str() const {
+    char text[160];
+    std::snprintf(text, sizeof(text),
+                  "Read %zu files in %zu shards: %zu lines, %.2f MB in %.3f s "
+                  "(%.2f MB/s)",
+                  files, shards, lines, static_cast<double>(bytes) / 1e6,
+                  seconds, megabytesPerSecond());
+    return text;
+  }
+};
+
+// Parallel driver processing many files with the same per-line logic.
+// Files are scheduled on work stealing ThreadPool, largest first. Plain
+// files bigger than range_size are mapped and split into byte ranges of
+// about that size, compressed ones are read whole with FileReader. BGZF
+// files opened by workers inflate on a single thread, see nested_workers.
+class MultiFileReader {
+private:
+  struct Shard {
+    size_t file{0};
+    uint64_t begin{0};
+    uint64_t end{0};
+    bool whole{true};
+  };
+
+  // Counters of worker padded to own cache line.
+  struct alignas(64) Counters {
+    size_t lines{0};
+    size_t bytes{0};
+  };
+
+  vector<string> files{};
+  size_t workers{1};
+  uint64_t range_size{default_range_size};
+
+  vector<Shard> plan() const {
+    vector<Shard> shards{};
+    for (size_t i = 0; i < files.size(); ++i) {
+      struct stat info {};
+      if (::stat(files[i].c_str(), &info) < 0)
+        throw runerror{"Can't stat '" + files[i] + "'\n"};
+      const auto size = static_cast<uint64_t>(info.st_size);
+
+      if (size <= range_size ||
+          detect_compression(files[i]) != Compression::None) {
+        shards.push_back({i, 0, size, true});
+        continue;
+      }
+      for (uint64_t begin = 0; begin < size; begin += range_size)
+        shards.push_back({i, begin, std::min(size, begin + range_size), false});
+    }
+
+    std::stable_sort(shards.begin(), shards.end(),
+                     [](const Shard &left, const Shard &right) {
+                       return left.end - left.begin > right.end - right.begin;
+                     });
+    return shards;
+  }
+
+  // Lines of split file belong to the range holding their first byte.
+  template <class Func>
+  static void read_range(const Shard &shard, const string &file_name,
+                         size_t worker, Counters &counters, Func &func) {
+    const MappedFile file{file_name};
+    const auto first = file.begin();
+    const auto last = file.end();
+
+    const auto align = [first, last](uint64_t offset) {
+      if (!offset)
+        return first;
+      if (offset >= static_cast<uint64_t>(last - first))
+        return last;
+      const auto found = Simd::find_byte(first + offset - 1, last, '\n');
+      return found == last ? last : found + 1;
+    };
+
+    for (const auto line : LineRange{align(shard.begin), align(shard.end)}) {
+      func(worker, shard.file, line);
+      ++counters.lines;
+      counters.bytes += line.size() + (line.data() + line.size() != last);
+    }
+  }
+
+  template <class Func>
+  static void read_whole(const Shard &shard, const string &file_name,
+                         size_t worker, Counters &counters, Func &func) {
+    FileReader reader{file_name, ReadMode::Block};
+    while (reader.nextLine()) {
+      const auto line = reader.getLineView();
+      func(worker, shard.file, line);
+      ++counters.lines;
+      counters.bytes += line.size() + reader.good();
+    }
+  }
+
+public:
+  static constexpr uint64_t default_range_size{64 << 20};
+
+  MultiFileReader() = delete;
+  MultiFileReader(vector<string> files, size_t workers = default_workers(),
+                  uint64_t range_size = default_range_size)
+      : files{std::move(files)}, workers{std::max<size_t>(workers, 1)},
+        range_size{std::max<uint64_t>(range_size, 1)} {}
+
+  const vector<string> &getFiles() const noexcept { return files; }
+  size_t size() const noexcept { return files.size(); }
+  size_t getWorkers() const noexcept { return workers; }
+
+  // Function calls func(size_t worker, size_t file, string_view line) for
+  // every line, where worker is index of calling thread below getWorkers(),
+  // so per-thread state can be kept without locking, and file indexes
+  // getFiles(). Lines of one file are not ordered between shards.
+  // Exceptions are rethrown after all shards finished.
+  template <class Func> ReadSummary forEachLine(Func func) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto shards = plan();
+
+    vector<Counters> counters(workers);
+    {
+      Parallel::ThreadPool pool{workers};
+      vector<std::future<void>> futures{};
+      futures.reserve(shards.size());
+
+      for (const auto &shard : shards)
+        futures.push_back(pool.submit([&, shard]() {
+          const auto worker = pool.index();
+          if (shard.whole)
+            read_whole(shard, files[shard.file], worker, counters[worker],
+                       func);
+          else
+            read_range(shard, files[shard.file], worker, counters[worker],
+                       func);
+        }));
+
+      for (auto &future : futures)
+        future.wait();
+      for (auto &future : futures)
+        future.get();
+    }
+
+    ReadSummary summary{files.size(), shards.size()};
+    for (const auto &ele : counters) {
+      summary.lines += ele.lines;
+      summary.bytes += ele.bytes;
+    }
+    summary.seconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    return summary;
+  }
+};
+
+// Byte offsets of every step-th line of file.
+// Index is stored in sidecar file next to indexed one, together with size
+// and modification time used to detect stale index.
+class LineIndex {
+private:
+  static constexpr char magic[8]{'A', 'G', 'Z', 'L', 'I', 'D', 'X', '1'};
+
+  string file_name{};
+  uint64_t step{default_step};
+  uint64_t file_size{0};
+  uint64_t file_time{0};
+  uint64_t lines{0};
+  vector<uint64_t> offsets{};
+
+  static std::pair<uint64_t, uint64_t> stamp(const string &file_name) {
+    struct stat info {};
+    if (::stat(file_name.c_str(), &info) < 0)
+      throw runerror{"Can't stat '" + file_name + "'\n"};
+    return {static_cast<uint64_t>(info.st_size),
+            static_cast<uint64_t>(info.st_mtim.tv_sec) * 1000000000u +
+                static_cast<uint64_t>(info.st_mtim.tv_nsec)};
+  }
+
+public:
+  static constexpr uint64_t default_step{1024};
+
+  LineIndex() = default;
+
+  static string sidecar(string_view file_name) {
+    return string(file_name) + ".lidx";
+  }
+
+  // Function scans file in parallel ranges and records offsets of lines
+  // 1, step + 1, 2 * step + 1, etc.
+  static LineIndex build(string_view file_name, uint64_t step = default_step,
+                         size_t workers = default_workers()) {
+    LineIndex result{};
+    result.file_name = string(file_name);
+    result.step = std::max<uint64_t>(step, 1);
+    std::tie(result.file_size, result.file_time) = stamp(result.file_name);
+
+    ParallelReader reader{file_name, workers, true};
+    const auto origin = reader.view().data();
+
+    result.offsets = reader.reduce(
+        vector<uint64_t>{},
+        [origin, step = result.step](const LineRange &range) {
+          vector<uint64_t> found{};
+          const auto last = range.view().data() + range.size();
+          auto pos = range.view().data();
+          for (auto line = static_cast<uint64_t>(range.getFirstLine());
+               pos != last; ++line) {
+            if ((line - 1) % step == 0)
+              found.push_back(static_cast<uint64_t>(pos - origin));
+            pos = Simd::find_byte(pos, last, '\n');
+            if (pos != last)
+              ++pos;
+          }
+          return found;
+        },
+        [](vector<uint64_t> result, const vector<uint64_t> &found) {
+          result.insert(result.end(), found.begin(), found.end());
+          return result;
+        });
+    result.lines = static_cast<uint64_t>(reader.getLines());
+
+    return result;
+  }
+
+  // Function returns false when sidecar file is missing, damaged or does not
+  // match current size and modification time of file. Offsets must be
+  // strictly increasing and lie within file, so damaged index is never used.
+  bool load(string_view file_name) {
+    std::ifstream input(sidecar(file_name), std::ios::binary | std::ios::ate);
+    if (!input)
+      return false;
+    const auto sidecar_size = static_cast<uint64_t>(input.tellg());
+    input.seekg(0);
+
+    char header[sizeof(magic)]{};
+    uint64_t values[5]{};
+    input.read(header, sizeof(header));
+    input.read(reinterpret_cast<char *>(values), sizeof(values));
+    if (!input || !std::equal(header, header + sizeof(header), magic))
+      return false;
+
+    const auto [size, time] = stamp(string(file_name));
+    if (values[1] != size || values[2] != time)
+      return false;
+
+    // Count is checked against both file and sidecar size before allocating.
+    const auto count = values[4];
+    const auto header_size = sizeof(magic) + sizeof(values);
+    if (!values[0] || count > size / values[0] + 1 ||
+        count != (sidecar_size - header_size) / sizeof(uint64_t))
+      return false;
+
+    vector<uint64_t> found(count);
+    input.read(reinterpret_cast<char *>(found.data()),
+               static_cast<std::streamsize>(found.size() * sizeof(uint64_t)));
+    if (!input)
+      return false;
+
+    for (size_t i = 0; i < found.size(); ++i)
+      if (found[i] >= size || (i && found[i] <= found[i - 1]))
+        return false;
+
+    this->file_name = string(file_name);
+    step = values[0];
+    file_size = size;
+    file_time = time;
+    lines = values[3];
+    offsets = std::move(found);
+
+    return true;
+  }
+
+  void save() const {
+    const auto name = sidecar(file_name);
+    std::ofstream output(name, std::ios::binary);
+
+    const uint64_t values[5]{step, file_size, file_time, lines,
+                             offsets.size()};
+    output.write(magic, sizeof(magic));
+    output.write(reinterpret_cast<const char *>(values), sizeof(values));
+    output.write(reinterpret_cast<const char *>(offsets.data()),
+                 static_cast<std::streamsize>(offsets.size() *
+                                              sizeof(uint64_t)));
+    if (!output)
+      throw runerror{"Can't write '" + name + "'\n"};
+  }
+
+  // Function loads valid sidecar index or builds new one and tries to save
+  // it. Index is still returned when sidecar can't be written.
+  static LineIndex open(string_view file_name, uint64_t step = default_step) {
+    LineIndex result{};
+    if (result.load(file_name))
+      return result;
+
+    result = build(file_name, step);
+    try {
+      result.save();
+    } catch (const runerror &) {
+    }
+
+    return result;
+  }
+
+  bool isStale() const {
+    return stamp(file_name) != std::pair{file_size, file_time};
+  }
+
+  uint64_t getStep() const noexcept { return step; }
+  uint64_t getLines() const noexcept { return lines; }
+  size_t size() const noexcept { return offsets.size(); }
+  const vector<uint64_t> &getOffsets() const noexcept { return offsets; }
+
+  // Function returns number of the nearest indexed line not greater than
+  // line_num together with its offset.
+  std::pair<long, uint64_t> locate(long line_num) const noexcept {
+    if (offsets.empty() || line_num < 1)
+      return {1, 0};
+    const auto pos = std::min(static_cast<size_t>(line_num - 1) / step,
+                              offsets.size() - 1);
+    return {static_cast<long>(pos * step + 1), offsets[pos]};
+  }
+};
+
+inline bool FileReader::seekLine(long line_num) {
+  // Rewinding first fails early for sources that can't seek at all.
+  input->seek(0);
+  line_num = std::max(line_num, 1L);
+
+  // Stamp is checked on every use, so appended or rewritten file is never
+  // looked up with old offsets.
+  if (!index || index->isStale())
+    index = std::make_shared<const LineIndex>(LineIndex::open(file_name));
+
+  const auto [found, offset] = index->locate(line_num);
+  input->seek(offset);
+  line = {};
+  this->line_num = static_cast<int>(found - 1);
+
+  return readLine(static_cast<int>(line_num - found + 1));
+}
+
 } // namespace AGizmo::Files
@@ -6,6 +6,9 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
+
+#include "strings.hpp"
 
 namespace AGizmo::Logging {
 
@@ -66,19 +69,17 @@ public:
   }
 
   auto str() const {
-    sstream output;
-
-    auto hours = this->getHours();
-    auto minutes = this->getMinutes() % 60;
-    auto seconds = this->getSeconds() % 60;
-    auto mili = this->getMili() % 1000;
+    StringCompose::StringBuilder output{16};
 
-    output << std::setw(2) << std::setfill('0') << hours << "h:" << std::setw(2)
-           << std::setfill('0') << minutes << "m:" << std::setw(2)
-           << std::setfill('0') << seconds << "s." << std::setw(3)
-           << std::setfill('0') << mili;
+    output.append(this->getHours(), 2)
+        .append("h:")
+        .append(this->getMinutes() % 60, 2)
+        .append("m:")
+        .append(this->getSeconds() % 60, 2)
+        .append("s.")
+        .append(this->getMili() % 1000, 3);
 
-    return output.str();
+    return std::move(output).str();
   }
 
   friend ostream &operator<<(ostream &stream, const Timer &item) {
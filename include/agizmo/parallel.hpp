@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace AGizmo::Parallel {
+
+using std::vector;
+
+inline size_t default_workers() noexcept {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Fixed size pool of worker threads with work stealing.
+// Every worker has its own queue: tasks submitted from outside are spread
+// over queues in turns, tasks submitted by a worker go to its own queue.
+// Worker takes tasks from the front of its queue and, when it is empty,
+// steals from the back of others. Function submit returns future holding
+// result or exception of the task.
+class ThreadPool {
+private:
+  struct Queue {
+    std::mutex guard{};
+    std::deque<std::function<void()>> tasks{};
+  };
+
+  vector<std::thread> workers{};
+  std::unique_ptr<Queue[]> queues{};
+  size_t count{0};
+  size_t turn{0};
+  size_t pending{0};
+  std::mutex guard{};
+  std::condition_variable signal{};
+  bool stopping{false};
+
+  // Pool and index of worker running on the current thread.
+  static std::pair<const ThreadPool *, size_t> &current() noexcept {
+    thread_local std::pair<const ThreadPool *, size_t> worker{nullptr, 0};
+    return worker;
+  }
+
+  bool take(size_t index, std::function<void()> &task) {
+    for (size_t i = 0; i < count; ++i) {
+      auto &queue = queues[(index + i) % count];
+      std::lock_guard lock{queue.guard};
+      if (queue.tasks.empty())
+        continue;
+      if (!i) {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      } else {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void work(size_t index) {
+    current() = {this, index};
+    while (true) {
+      std::function<void()> task;
+      if (take(index, task)) {
+        {
+          std::lock_guard lock{guard};
+          --pending;
+        }
+        task();
+        continue;
+      }
+
+      std::unique_lock lock{guard};
+      signal.wait(lock, [this]() { return stopping || pending; });
+      if (!pending)
+        return;
+    }
+  }
+
+public:
+  explicit ThreadPool(size_t count = default_workers())
+      : queues{std::make_unique<Queue[]>(std::max<size_t>(count, 1))},
+        count{std::max<size_t>(count, 1)} {
+    workers.reserve(this->count);
+    for (size_t i = 0; i < this->count; ++i)
+      workers.emplace_back(&ThreadPool::work, this, i);
+  }
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Pending tasks are finished before workers are joined.
+  ~ThreadPool() {
+    {
+      std::lock_guard lock{guard};
+      stopping = true;
+    }
+    signal.notify_all();
+    for (auto &worker : workers)
+      worker.join();
+  }
+
+  size_t size() const noexcept { return workers.size(); }
+
+  // Function returns true when called by worker of any pool.
+  static bool inWorker() noexcept { return current().first != nullptr; }
+
+  // Function returns index of worker calling it, or size() when called from
+  // thread outside of the pool.
+  size_t index() const noexcept {
+    const auto &[pool, index] = current();
+    return pool == this ? index : size();
+  }
+
+  template <class Func>
+  std::future<std::invoke_result_t<Func &>> submit(Func func) {
+    using Result = std::invoke_result_t<Func &>;
+
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+    auto result = task->get_future();
+
+    // Task is counted as pending before any worker can take it.
+    {
+      std::lock_guard lock{guard};
+      auto target = index();
+      if (target == count)
+        target = turn++ % count;
+
+      std::lock_guard queue_lock{queues[target].guard};
+      queues[target].tasks.emplace_back([task]() { (*task)(); });
+      ++pending;
+    }
+    signal.notify_one();
+
+    return result;
+  }
+};
+
+} // namespace AGizmo::Parallel
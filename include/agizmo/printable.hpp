@@ -5,6 +5,7 @@
 #include <map>
 #include <optional>
 #include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -251,47 +252,47 @@ public:
 
   string join_fields(bool ordered = true, char names = ';',
                      char values = '=') const {
-    if (items.empty())
-      return "";
+    StringCompose::StringBuilder output;
+    bool front{true};
 
-    sstream output;
+    const auto append = [&](const string &key, const opt_str &value) {
+      if (!std::exchange(front, false))
+        output << names;
+      output << key;
+      if (value)
+        output << values << *value;
+    };
 
     if (ordered) {
-      for (const auto &key : keys) {
-        output << names << key;
-        if (const auto &value = items.at(key))
-          output << values << *value;
-      }
+      for (const auto &key : keys)
+        append(key, items.at(key));
     } else {
-      for (const auto &[key, value] : items) {
-        output << names << key;
-        if (value)
-          output << values << *value;
-      }
+      for (const auto &[key, value] : items)
+        append(key, value);
     }
 
-    return output.str().substr(1);
+    return std::move(output).str();
   }
 
   template <class It>
   string join_fields(It begin, It end, char names = ';', char values = '=',
                      std::function<string(const string &)> modify =
                          [](const string &ele) { return ele; }) const {
-    if (items.empty())
-      return "";
-
-    sstream output;
+    StringCompose::StringBuilder output;
+    bool front{true};
 
     for (auto key = begin; key != end; ++key) {
       if (const auto item = this->get(*key)) {
-        output << names << *key;
+        if (!std::exchange(front, false))
+          output << names;
+        output << *key;
         if (const auto &value = *item)
           if (value)
             output << values << modify(*value);
       }
     }
 
-    return output.str().substr(1);
+    return std::move(output).str();
   }
 
   string str() const { return join_fields(); }
@@ -0,0 +1,1387 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AGIZMO_SIMD_X86 1
+#endif
+
+namespace AGizmo::Simd {
+
+// Instruction sets available at runtime.
+// Library is compiled for baseline x86-64 (SSE2), wider kernels are compiled
+// with target attributes and selected once, on first use.
+struct Cpu {
+  bool ssse3{false};
+  bool avx2{false};
+  bool avx512bw{false};
+
+  static Cpu detect() noexcept {
+    Cpu result{};
+#ifdef AGIZMO_SIMD_X86
+    __builtin_cpu_init();
+    result.ssse3 = __builtin_cpu_supports("ssse3");
+    result.avx2 = __builtin_cpu_supports("avx2");
+    result.avx512bw = __builtin_cpu_supports("avx512bw");
+#endif
+    return result;
+  }
+
+  static const Cpu &get() noexcept {
+    static const Cpu cpu{detect()};
+    return cpu;
+  }
+};
+
+namespace Kernel {
+
+inline size_t count_byte_scalar(const char *first, const char *last,
+                                char query) noexcept {
+  size_t result{0};
+  for (; first != last; ++first)
+    result += *first == query;
+  return result;
+}
+
+inline const char *find_byte_scalar(const char *first, const char *last,
+                                    char query) noexcept {
+  if (first == last)
+    return last;
+  const auto found =
+      std::memchr(first, query, static_cast<size_t>(last - first));
+  return found ? static_cast<const char *>(found) : last;
+}
+
+#ifdef AGIZMO_SIMD_X86
+
+inline const char *find_byte_sse2(const char *first, const char *last,
+                                  char query) noexcept {
+  const auto needle = _mm_set1_epi8(query);
+
+  for (; last - first >= 16; first += 16) {
+    const auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    if (const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)))
+      return first + __builtin_ctz(static_cast<unsigned>(mask));
+  }
+
+  for (; first != last; ++first)
+    if (*first == query)
+      return first;
+
+  return last;
+}
+
+__attribute__((target("avx2"))) inline const char *
+find_byte_avx2(const char *first, const char *last, char query) noexcept {
+  const auto needle = _mm256_set1_epi8(query);
+
+  for (; last - first >= 64; first += 64) {
+    const auto low = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first)), needle);
+    const auto high = _mm256_cmpeq_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + 32)),
+        needle);
+    if (!_mm256_testz_si256(_mm256_or_si256(low, high),
+                            _mm256_or_si256(low, high))) {
+      if (const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(low)))
+        return first + __builtin_ctz(mask);
+      return first + 32 +
+             __builtin_ctz(static_cast<unsigned>(_mm256_movemask_epi8(high)));
+    }
+  }
+
+  for (; last - first >= 32; first += 32) {
+    const auto block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    if (const auto mask = static_cast<unsigned>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle))))
+      return first + __builtin_ctz(mask);
+  }
+
+  return find_byte_sse2(first, last, query);
+}
+
+inline size_t count_byte_sse2(const char *first, const char *last,
+                              char query) noexcept {
+  const auto needle = _mm_set1_epi8(query);
+  const auto zero = _mm_setzero_si128();
+  size_t result{0};
+
+  // Byte counters are flushed before they can overflow after 255 rounds.
+  while (last - first >= 16) {
+    auto counters = zero;
+    const auto rounds =
+        std::min<size_t>(static_cast<size_t>(last - first) / 16, 255);
+    for (size_t i = 0; i < rounds; ++i, first += 16)
+      counters = _mm_sub_epi8(
+          counters,
+          _mm_cmpeq_epi8(
+              _mm_loadu_si128(reinterpret_cast<const __m128i *>(first)),
+              needle));
+    const auto sums = _mm_sad_epu8(counters, zero);
+    result += static_cast<size_t>(_mm_extract_epi16(sums, 0) +
+                                  _mm_extract_epi16(sums, 4));
+  }
+
+  for (; first != last; ++first)
+    result += *first == query;
+
+  return result;
+}
+
+__attribute__((target("avx2"))) inline size_t
+count_byte_avx2(const char *first, const char *last, char query) noexcept {
+  const auto needle = _mm256_set1_epi8(query);
+  const auto zero = _mm256_setzero_si256();
+  size_t result{0};
+
+  while (last - first >= 32) {
+    auto counters = zero;
+    const auto rounds =
+        std::min<size_t>(static_cast<size_t>(last - first) / 32, 255);
+    for (size_t i = 0; i < rounds; ++i, first += 32)
+      counters = _mm256_sub_epi8(
+          counters,
+          _mm256_cmpeq_epi8(
+              _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first)),
+              needle));
+    const auto sums = _mm256_sad_epu8(counters, zero);
+    result += static_cast<size_t>(
+        _mm256_extract_epi16(sums, 0) + _mm256_extract_epi16(sums, 4) +
+        _mm256_extract_epi16(sums, 8) + _mm256_extract_epi16(sums, 12));
+  }
+
+  return result + count_byte_sse2(first, last, query);
+}
+
+#endif
+
+} // namespace Kernel
+
+// Function returns pointer to the first occurence of query in [first, last)
+// or last if query was not found.
+inline const char *find_byte(const char *first, const char *last,
+                             char query) noexcept {
+#ifdef AGIZMO_SIMD_X86
+  static const auto kernel =
+      Cpu::get().avx2 ? Kernel::find_byte_avx2 : Kernel::find_byte_sse2;
+  return kernel(first, last, query);
+#else
+  return Kernel::find_byte_scalar(first, last, query);
+#endif
+}
+
+// Function counts occurences of query in [first, last).
+inline size_t count_byte(const char *first, const char *last,
+                         char query) noexcept {
+#ifdef AGIZMO_SIMD_X86
+  static const auto kernel =
+      Cpu::get().avx2 ? Kernel::count_byte_avx2 : Kernel::count_byte_sse2;
+  return kernel(first, last, query);
+#else
+  return Kernel::count_byte_scalar(first, last, query);
+#endif
+}
+
+// Set of bytes classified with two pshufb lookups: every distinct high
+// nibble of members gets its own bit, table of low nibbles holds bits of
+// high nibbles it is combined with. Sets with more than 8 distinct high
+// nibbles are served by scalar table only.
+class ByteSet {
+private:
+  std::array<bool, 256> members{};
+  uint8_t low[16]{};
+  uint8_t high[16]{};
+  unsigned groups{0};
+  bool nibbles{true};
+
+public:
+  ByteSet() = default;
+  ByteSet(const char *first, const char *last) noexcept {
+    for (; first != last; ++first)
+      insert(*first);
+  }
+
+  void insert(char byte) noexcept {
+    const auto value = static_cast<unsigned char>(byte);
+    if (members[value])
+      return;
+    members[value] = true;
+
+    auto &group = high[value >> 4];
+    if (!group) {
+      if (groups == 8) {
+        nibbles = false;
+        return;
+      }
+      group = static_cast<uint8_t>(1u << groups++);
+    }
+    low[value & 0x0f] |= group;
+  }
+
+  bool contains(char byte) const noexcept {
+    return members[static_cast<unsigned char>(byte)];
+  }
+
+  bool hasNibbles() const noexcept { return nibbles; }
+  const uint8_t *getLow() const noexcept { return low; }
+  const uint8_t *getHigh() const noexcept { return high; }
+};
+
+namespace Kernel {
+
+// Positions of set bits of every 8-bit mask, used to compact bytes with
+// pshufb.
+struct CompactTable {
+  uint8_t index[256][8]{};
+
+  constexpr CompactTable() {
+    for (unsigned mask = 0; mask < 256; ++mask) {
+      unsigned count{0};
+      for (unsigned bit = 0; bit < 8; ++bit)
+        if (mask >> bit & 1)
+          index[mask][count++] = static_cast<uint8_t>(bit);
+    }
+  }
+};
+
+inline constexpr CompactTable compact_table{};
+
+// Previous tells if byte before first was member of set.
+inline size_t collapse_bytes_tail(const char *first, const char *last,
+                                  const ByteSet &set, char *output,
+                                  bool previous) noexcept {
+  const auto start = output;
+  for (; first != last; ++first) {
+    const bool member = set.contains(*first);
+    if (!member || !previous)
+      *output++ = member ? ' ' : *first;
+    previous = member;
+  }
+  return static_cast<size_t>(output - start);
+}
+
+inline size_t collapse_bytes_scalar(const char *first, const char *last,
+                                    const ByteSet &set, char *output) noexcept {
+  return collapse_bytes_tail(first, last, set, output, false);
+}
+
+#ifdef AGIZMO_SIMD_X86
+
+// Function returns non-zero byte for every byte of block present in set
+// given by its nibble tables.
+__attribute__((target("ssse3"))) inline __m128i
+classify_ssse3(__m128i block, __m128i low, __m128i high) noexcept {
+  const auto nibble = _mm_set1_epi8(0x0f);
+  return _mm_and_si128(
+      _mm_shuffle_epi8(low, _mm_and_si128(block, nibble)),
+      _mm_shuffle_epi8(high,
+                       _mm_and_si128(_mm_srli_epi16(block, 4), nibble)));
+}
+
+__attribute__((target("avx2"))) inline __m256i
+classify_avx2(__m256i block, __m256i low, __m256i high) noexcept {
+  const auto nibble = _mm256_set1_epi8(0x0f);
+  return _mm256_and_si256(
+      _mm256_shuffle_epi8(low, _mm256_and_si256(block, nibble)),
+      _mm256_shuffle_epi8(
+          high, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble)));
+}
+
+// Members of every block are turned into spaces, members following other
+// member are dropped and remaining bytes are compacted in halves of 8 bytes.
+// Output never passes the block being read, so it can overlap input.
+__attribute__((target("ssse3"))) inline size_t
+collapse_bytes_ssse3(const char *first, const char *last, const ByteSet &set,
+                     char *output) noexcept {
+  if (!set.hasNibbles())
+    return collapse_bytes_scalar(first, last, set, output);
+
+  const auto low =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getLow()));
+  const auto high =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getHigh()));
+  const auto space = _mm_set1_epi8(' ');
+  const auto zero = _mm_setzero_si128();
+  const auto start = output;
+  unsigned carry{0};
+
+  for (; last - first >= 16; first += 16) {
+    const auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    const auto classes = classify_ssse3(block, low, high);
+    const auto other = _mm_cmpeq_epi8(classes, zero);
+    const auto mapped = _mm_or_si128(_mm_and_si128(other, block),
+                                     _mm_andnot_si128(other, space));
+
+    const auto members =
+        ~static_cast<unsigned>(_mm_movemask_epi8(other)) & 0xffff;
+    const auto dropped = members & (members << 1 | carry);
+    carry = members >> 15;
+
+    if (!dropped) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(output), mapped);
+      output += 16;
+      continue;
+    }
+
+    const auto kept = ~dropped & 0xffff;
+    const auto kept_low = kept & 0xff;
+    const auto kept_high = kept >> 8;
+    const auto index_low = _mm_loadl_epi64(
+        reinterpret_cast<const __m128i *>(compact_table.index[kept_low]));
+    const auto index_high = _mm_loadl_epi64(
+        reinterpret_cast<const __m128i *>(compact_table.index[kept_high]));
+
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(output),
+                     _mm_shuffle_epi8(mapped, index_low));
+    output += __builtin_popcount(kept_low);
+    _mm_storel_epi64(
+        reinterpret_cast<__m128i *>(output),
+        _mm_shuffle_epi8(mapped, _mm_add_epi8(index_high, _mm_set1_epi8(8))));
+    output += __builtin_popcount(kept_high);
+  }
+
+  return static_cast<size_t>(output - start) +
+         collapse_bytes_tail(first, last, set, output, carry);
+}
+
+#endif
+
+} // namespace Kernel
+
+// Function copies [first, last) to output turning members of set into spaces
+// and dropping members following another member, so every run of members
+// becomes single space. Returns size of output, which is at most size of
+// input. Output may start at first, which cleans the buffer in place.
+inline size_t collapse_bytes(const char *first, const char *last,
+                             const ByteSet &set, char *output) noexcept {
+#ifdef AGIZMO_SIMD_X86
+  static const auto kernel = Cpu::get().ssse3 ? Kernel::collapse_bytes_ssse3
+                                              : Kernel::collapse_bytes_scalar;
+  return kernel(first, last, set, output);
+#else
+  return Kernel::collapse_bytes_scalar(first, last, set, output);
+#endif
+}
+
+namespace Kernel {
+
+inline size_t count_set_scalar(const char *first, const char *last,
+                               const ByteSet &set) noexcept {
+  size_t result{0};
+  for (; first != last; ++first)
+    result += set.contains(*first);
+  return result;
+}
+
+inline const char *find_set_scalar(const char *first, const char *last,
+                                   const ByteSet &set) noexcept {
+  return std::find_if(first, last,
+                      [&set](char byte) { return set.contains(byte); });
+}
+
+#ifdef AGIZMO_SIMD_X86
+
+// Members are counted in byte counters like in count_byte kernels.
+__attribute__((target("ssse3"))) inline size_t
+count_set_ssse3(const char *first, const char *last,
+                const ByteSet &set) noexcept {
+  if (!set.hasNibbles())
+    return count_set_scalar(first, last, set);
+
+  const auto low =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getLow()));
+  const auto high =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getHigh()));
+  const auto one = _mm_set1_epi8(1);
+  const auto zero = _mm_setzero_si128();
+  size_t result{0};
+
+  while (last - first >= 16) {
+    auto counters = zero;
+    const auto rounds =
+        std::min<size_t>(static_cast<size_t>(last - first) / 16, 255);
+    for (size_t i = 0; i < rounds; ++i, first += 16) {
+      const auto block =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+      counters = _mm_add_epi8(
+          counters, _mm_min_epu8(classify_ssse3(block, low, high), one));
+    }
+    const auto sums = _mm_sad_epu8(counters, zero);
+    result += static_cast<size_t>(_mm_extract_epi16(sums, 0) +
+                                  _mm_extract_epi16(sums, 4));
+  }
+
+  return result + count_set_scalar(first, last, set);
+}
+
+__attribute__((target("avx2"))) inline size_t
+count_set_avx2(const char *first, const char *last,
+               const ByteSet &set) noexcept {
+  if (!set.hasNibbles())
+    return count_set_scalar(first, last, set);
+
+  const auto low = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getLow())));
+  const auto high = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getHigh())));
+  const auto one = _mm256_set1_epi8(1);
+  const auto zero = _mm256_setzero_si256();
+  size_t result{0};
+
+  while (last - first >= 32) {
+    auto counters = zero;
+    const auto rounds =
+        std::min<size_t>(static_cast<size_t>(last - first) / 32, 255);
+    for (size_t i = 0; i < rounds; ++i, first += 32) {
+      const auto block =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+      counters = _mm256_add_epi8(
+          counters, _mm256_min_epu8(classify_avx2(block, low, high), one));
+    }
+    const auto sums = _mm256_sad_epu8(counters, zero);
+    result += static_cast<size_t>(
+        _mm256_extract_epi16(sums, 0) + _mm256_extract_epi16(sums, 4) +
+        _mm256_extract_epi16(sums, 8) + _mm256_extract_epi16(sums, 12));
+  }
+
+  return result + count_set_scalar(first, last, set);
+}
+
+__attribute__((target("ssse3"))) inline const char *
+find_set_ssse3(const char *first, const char *last,
+               const ByteSet &set) noexcept {
+  if (!set.hasNibbles())
+    return find_set_scalar(first, last, set);
+
+  const auto low =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getLow()));
+  const auto high =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getHigh()));
+  const auto zero = _mm_setzero_si128();
+
+  for (; last - first >= 16; first += 16) {
+    const auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    const auto other = static_cast<unsigned>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(classify_ssse3(block, low, high), zero)));
+    if (const auto mask = ~other & 0xffff)
+      return first + __builtin_ctz(mask);
+  }
+
+  return find_set_scalar(first, last, set);
+}
+
+__attribute__((target("avx2"))) inline const char *
+find_set_avx2(const char *first, const char *last,
+              const ByteSet &set) noexcept {
+  if (!set.hasNibbles())
+    return find_set_scalar(first, last, set);
+
+  const auto low = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getLow())));
+  const auto high = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(set.getHigh())));
+  const auto zero = _mm256_setzero_si256();
+
+  for (; last - first >= 32; first += 32) {
+    const auto block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+    const auto other = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(classify_avx2(block, low, high), zero)));
+    if (const auto mask = ~other)
+      return first + __builtin_ctz(mask);
+  }
+
+  return find_set_ssse3(first, last, set);
+}
+
+#endif
+
+} // namespace Kernel
+
+// Function counts bytes of [first, last) present in set.
+inline size_t count_set(const char *first, const char *last,
+                        const ByteSet &set) noexcept {
+#ifdef AGIZMO_SIMD_X86
+  static const auto kernel = Cpu::get().avx2    ? Kernel::count_set_avx2
+                             : Cpu::get().ssse3 ? Kernel::count_set_ssse3
+                                                : Kernel::count_set_scalar;
+  return kernel(first, last, set);
+#else
+  return Kernel::count_set_scalar(first, last, set);
+#endif
+}
+
+// Function returns pointer to the first byte of [first, last) present in set
+// or last if there is none.
+inline const char *find_set(const char *first, const char *last,
+                            const ByteSet &set) noexcept {
+#ifdef AGIZMO_SIMD_X86
+  static const auto kernel = Cpu::get().avx2    ? Kernel::find_set_avx2
+                             : Cpu::get().ssse3 ? Kernel::find_set_ssse3
+                                                : Kernel::find_set_scalar;
+  return kernel(first, last, set);
+#else
+  return Kernel::find_set_scalar(first, last, set);
+#endif
+}
+
+namespace Kernel {
+
+inline const char *find_substring_scalar(const char *first, const char *last,
+                                         const char *needle,
+                                         size_t size) noexcept {
+  if (static_cast<size_t>(last - first) < size)
+    return last;
+  const auto found =
+      memmem(first, static_cast<size_t>(last - first), needle, size);
+  return found ? static_cast<const char *>(found) : last;
+}
+
+#ifdef AGIZMO_SIMD_X86
+
+// Kernels compare first and last byte of needle with two shifted loads, only
+// positions matching both are verified with memcmp. Needle has at least two
+// bytes, positions left at the end are searched with memmem.
+inline const char *find_substring_sse2(const char *first, const char *last,
+                                       const char *needle,
+                                       size_t size) noexcept {
+  const auto front = _mm_set1_epi8(needle[0]);
+  const auto back = _mm_set1_epi8(needle[size - 1]);
+
+  auto pos = first;
+  for (; static_cast<size_t>(last - pos) >= size + 15; pos += 16) {
+    const auto head = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+    const auto tail = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(pos + size - 1));
+    auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(head, front), _mm_cmpeq_epi8(tail, back))));
+
+    for (; mask; mask &= mask - 1) {
+      const auto candidate = pos + __builtin_ctz(mask);
+      if (!std::memcmp(candidate + 1, needle + 1, size - 2))
+        return candidate;
+    }
+  }
+
+  return find_substring_scalar(pos, last, needle, size);
+}
+
+__attribute__((target("avx2"))) inline const char *
+find_substring_avx2(const char *first, const char *last, const char *needle,
+                    size_t size) noexcept {
+  const auto front = _mm256_set1_epi8(needle[0]);
+  const auto back = _mm256_set1_epi8(needle[size - 1]);
+
+  auto pos = first;
+  for (; static_cast<size_t>(last - pos) >= size + 31; pos += 32) {
+    const auto head =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos));
+    const auto tail = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(pos + size - 1));
+    auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(
+        _mm256_cmpeq_epi8(head, front), _mm256_cmpeq_epi8(tail, back))));
+
+    for (; mask; mask &= mask - 1) {
+      const auto candidate = pos + __builtin_ctz(mask);
+      if (!std::memcmp(candidate + 1, needle + 1, size - 2))
+        return candidate;
+    }
+  }
+
+  return find_substring_sse2(pos, last, needle, size);
+}
+
+#endif
+
+} // namespace Kernel
+
+// Function returns pointer to the first occurence of needle of given size in
+// [first, last) or last if it was not found. Meant for short needles, where
+// filtering by first and last byte rejects most positions.
+inline const char *find_substring(const char *first, const char *last,
+                                  const char *needle, size_t size) noexcept {
+  if (size < 2)
+    return size ? find_byte(first, last, *needle) : first;
+#ifdef AGIZMO_SIMD_X86
+  static const auto kernel = Cpu::get().avx2 ? Kernel::find_substring_avx2
+                                             : Kernel::find_substring_sse2;
+  return kernel(first, last, needle, size);
+#else
+  return Kernel::find_substring_scalar(first, last, needle, size);
+#endif
+}
+
+namespace Kernel {
+
+// Function appends offsets of set bits of mask, each increased by base.
+inline void emit_positions(uint64_t mask, size_t base,
+                           std::vector<size_t> &positions) {
+  for (; mask; mask &= mask - 1)
+    positions.push_back(base + static_cast<size_t>(__builtin_ctzll(mask)));
+}
+
+inline void find_all_byte_scalar(const char *first, const char *last,
+                                 char query, std::vector<size_t> &positions) {
+  for (auto pos = first; (pos = find_byte_scalar(pos, last, query)) != last;
+       ++pos)
+    positions.push_back(static_cast<size_t>(pos - first));
+}
+
+#ifdef AGIZMO_SIMD_X86
+
+// Kernels compare blocks of 64 bytes at once and turn comparison into 64-bit
+// mask, so positions are extracted with one ctz per match.
+inline void find_all_byte_sse2(const char *first, const char *last,
+                               char query, std::vector<size_t> &positions) {
+  const auto needle = _mm_set1_epi8(query);
+  const auto mask_of = [needle](const char *block) {
+    return static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(block)),
+            needle))));
+  };
+
+  auto pos = first;
+  for (; last - pos >= 64; pos += 64)
+    emit_positions(mask_of(pos) | mask_of(pos + 16) << 16 |
+                       mask_of(pos + 32) << 32 | mask_of(pos + 48) << 48,
+                   static_cast<size_t>(pos - first), positions);
+
+  for (; pos != last; ++pos)
+    if (*pos == query)
+      positions.push_back(static_cast<size_t>(pos - first));
+}
+
+__attribute__((target("avx2"))) inline void
+find_all_byte_avx2(const char *first, const char *last, char query,
+                   std::vector<size_t> &positions) {
+  const auto needle = _mm256_set1_epi8(query);
+
+  auto pos = first;
+  for (; last - pos >= 64; pos += 64) {
+    const auto low = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos)),
+            needle)));
+    const auto high = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos + 32)),
+            needle)));
+    emit_positions(uint64_t{high} << 32 | low,
+                   static_cast<size_t>(pos - first), positions);
+  }
+
+  for (; pos != last; ++pos)
+    if (*pos == query)
+      positions.push_back(static_cast<size_t>(pos - first));
+}
+
+__attribute__((target("avx512bw"))) inline void
+find_all_byte_avx512(const char *first, const char *last, char query,
+                     std::vector<size_t> &positions) {
+  const auto needle = _mm512_set1_epi8(query);
+
+  auto pos = first;
+  for (; last - pos >= 64; pos += 64)
+    emit_positions(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(pos), needle),
+                   static_cast<size_t>(pos - first), positions);
+
+  // Tail is loaded with mask, so bytes past last are not touched.
+  if (pos != last) {
+    const auto valid = ~uint64_t{0} >> (64 - (last - pos));
+    emit_positions(
+        _mm512_mask_cmpeq_epi8_mask(
+            valid, _mm512_maskz_loadu_epi8(valid, pos), needle),
+        static_cast<size_t>(pos - first), positions);
+  }
+}
+
+#endif
+
+} // namespace Kernel
+
+// Function appends offsets (from first) of every occurence of query in
+// [first, last) to positions.
+inline void find_all_byte(const char *first, const char *last, char query,
+                          std::vector<size_t> &positions) {
+#ifdef AGIZMO_SIMD_X86
+  static const auto kernel = Cpu::get().avx512bw ? Kernel::find_all_byte_avx512
+                             : Cpu::get().avx2   ? Kernel::find_all_byte_avx2
+                                                 : Kernel::find_all_byte_sse2;
+  kernel(first, last, query, positions);
+#else
+  Kernel::find_all_byte_scalar(first, last, query, positions);
+#endif
+}
+
+namespace Kernel {
+
+// Function calls func(base + offset) for every set bit of mask.
+template <class Func>
+inline void emit_offsets(uint64_t mask, size_t base, Func &func) {
+  for (; mask; mask &= mask - 1)
+    func(base + static_cast<size_t>(__builtin_ctzll(mask)));
+}
+
+template <class Func>
+inline void for_each_byte_scalar(const char *first, const char *pos,
+                                 const char *last, char query, Func &func) {
+  for (; pos != last; ++pos)
+    if (*pos == query)
+      func(static_cast<size_t>(pos - first));
+}
+
+#ifdef AGIZMO_SIMD_X86
+
+template <class Func>
+inline void for_each_byte_sse2(const char *first, const char *last,
+                               char query, Func &func) {
+  const auto needle = _mm_set1_epi8(query);
+  const auto mask_of = [needle](const char *block) {
+    return static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(block)),
+            needle))));
+  };
+
+  auto pos = first;
+  for (; last - pos >= 64; pos += 64)
+    emit_offsets(mask_of(pos) | mask_of(pos + 16) << 16 |
+                     mask_of(pos + 32) << 32 | mask_of(pos + 48) << 48,
+                 static_cast<size_t>(pos - first), func);
+  for_each_byte_scalar(first, pos, last, query, func);
+}
+
+template <class Func>
+__attribute__((target("avx2"))) inline void
+for_each_byte_avx2(const char *first, const char *last, char query,
+                   Func &func) {
+  const auto needle = _mm256_set1_epi8(query);
+
+  auto pos = first;
+  for (; last - pos >= 64; pos += 64) {
+    const auto low = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos)),
+            needle)));
+    const auto high = static_cast<uint32_t>(_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos + 32)),
+            needle)));
+    emit_offsets(uint64_t{high} << 32 | low, static_cast<size_t>(pos - first),
+                 func);
+  }
+  for_each_byte_scalar(first, pos, last, query, func);
+}
+
+#endif
+
+} // namespace Kernel
+
+// Function calls func(offset) for offset (from first) of every occurence of
+// query in [first, last), in order, so positions need no buffer. Kernels
+// build the same 64-bit masks as find_all_byte.
+template <class Func>
+inline void for_each_byte(const char *first, const char *last, char query,
+                          Func func) {
+#ifdef AGIZMO_SIMD_X86
+  if (Cpu::get().avx2)
+    Kernel::for_each_byte_avx2(first, last, query, func);
+  else
+    Kernel::for_each_byte_sse2(first, last, query, func);
+#else
+  Kernel::for_each_byte_scalar(first, first, last, query, func);
+#endif
+}
+
+namespace Kernel {
+
+// State of quoted scanning carried between blocks of 64 bytes: inside is all
+// ones when block starts within quotes, escaped is 1 when its first byte is
+// escaped.
+struct QuoteState {
+  uint64_t inside{0};
+  uint64_t escaped{0};
+};
+
+// Function returns mask with every bit set that follows odd number of set
+// bits below it, which for quote bits marks bytes within quotes.
+inline uint64_t prefix_xor(uint64_t mask) noexcept {
+  mask ^= mask << 1;
+  mask ^= mask << 2;
+  mask ^= mask << 4;
+  mask ^= mask << 8;
+  mask ^= mask << 16;
+  mask ^= mask << 32;
+  return mask;
+}
+
+// Function returns bytes escaped by odd runs of escape characters, following
+// simdjson ("Parsing Gigabytes of JSON per Second"): runs are found with
+// addition carrying through them and parity of their length comes from
+// position of their start.
+inline uint64_t escaped_bytes(uint64_t escape, uint64_t &previous) noexcept {
+  if (!escape) {
+    const auto escaped = previous;
+    previous = 0;
+    return escaped;
+  }
+
+  constexpr uint64_t even_bits{0x5555555555555555};
+  escape &= ~previous;
+  const auto follows = escape << 1 | previous;
+  const auto odd_starts = escape & ~even_bits & ~follows;
+  uint64_t even_starts;
+  previous = __builtin_add_overflow(odd_starts, escape, &even_starts);
+  return (even_bits ^ even_starts << 1) & follows;
+}
+
+// Function returns separators of a block lying outside quotes. Quotes and
+// separators that are escaped are ignored.
+inline uint64_t unquoted_separators(uint64_t sep, uint64_t quote,
+                                    uint64_t escape,
+                                    QuoteState &state) noexcept {
+  const auto escaped = escaped_bytes(escape, state.escaped);
+  const auto inside = prefix_xor(quote & ~escaped) ^ state.inside;
+  state.inside = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+  return sep & ~inside & ~escaped;
+}
+
+template <class Func>
+inline bool for_each_unquoted_scalar(const char *first, const char *last,
+                                     char sep, char quote, char escape,
+                                     Func &func) {
+  bool inside{false};
+  bool escaped{false};
+  for (auto pos = first; pos != last; ++pos) {
+    if (escaped)
+      escaped = false;
+    else if (escape && *pos == escape)
+      escaped = true;
+    else if (*pos == quote)
+      inside = !inside;
+    else if (*pos == sep && !inside)
+      func(static_cast<size_t>(pos - first));
+  }
+  return inside;
+}
+
+#ifdef AGIZMO_SIMD_X86
+
+// Masks of separators, quotes and escape characters of a block of 64 bytes.
+// Kernels load the tail into zeroed buffer and clear bits past its end.
+struct QuoteMasks {
+  uint64_t sep;
+  uint64_t quote;
+  uint64_t escape;
+};
+
+inline uint64_t byte_mask_sse2(const char *block, char query) noexcept {
+  const auto needle = _mm_set1_epi8(query);
+  uint64_t result{0};
+  for (int offset = 0; offset < 64; offset += 16)
+    result |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+                  _mm_loadu_si128(
+                      reinterpret_cast<const __m128i *>(block + offset)),
+                  needle)))}
+              << offset;
+  return result;
+}
+
+inline QuoteMasks quote_masks_sse2(const char *block, char sep, char quote,
+                                   char escape) noexcept {
+  return {byte_mask_sse2(block, sep), byte_mask_sse2(block, quote),
+          escape ? byte_mask_sse2(block, escape) : 0};
+}
+
+__attribute__((target("avx2"))) inline uint64_t
+byte_mask_avx2(const char *block, char query) noexcept {
+  const auto needle = _mm256_set1_epi8(query);
+  const auto low = static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block)),
+          needle)));
+  const auto high = static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32)),
+          needle)));
+  return uint64_t{high} << 32 | low;
+}
+
+__attribute__((target("avx2"))) inline QuoteMasks
+quote_masks_avx2(const char *block, char sep, char quote,
+                 char escape) noexcept {
+  return {byte_mask_avx2(block, sep), byte_mask_avx2(block, quote),
+          escape ? byte_mask_avx2(block, escape) : 0};
+}
+
+__attribute__((target("avx512bw"))) inline QuoteMasks
+quote_masks_avx512(const char *block, char sep, char quote,
+                   char escape) noexcept {
+  const auto data = _mm512_loadu_si512(block);
+  return {_mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8(sep)),
+          _mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8(quote)),
+          escape ? _mm512_cmpeq_epi8_mask(data, _mm512_set1_epi8(escape))
+                 : 0};
+}
+
+// Function scans blocks of 64 bytes with masks given by Masks, which has to
+// be callable from the kernel calling it.
+template <class Masks, class Func>
+inline bool for_each_unquoted_blocks(const char *first, const char *last,
+                                     char sep, char quote, char escape,
+                                     Masks masks, Func &func) {
+  QuoteState state{};
+  auto pos = first;
+  for (; last - pos >= 64; pos += 64) {
+    const auto block = masks(pos, sep, quote, escape);
+    emit_offsets(
+        unquoted_separators(block.sep, block.quote, block.escape, state),
+        static_cast<size_t>(pos - first), func);
+  }
+
+  if (pos != last) {
+    alignas(64) char tail[64]{};
+    std::memcpy(tail, pos, static_cast<size_t>(last - pos));
+    const auto valid = ~uint64_t{0} >> (64 - (last - pos));
+    const auto block = masks(tail, sep, quote, escape);
+    emit_offsets(unquoted_separators(block.sep & valid, block.quote & valid,
+                                     block.escape & valid, state),
+                 static_cast<size_t>(pos - first), func);
+  }
+  return state.inside;
+}
+
+template <class Func>
+inline bool for_each_unquoted_sse2(const char *first, const char *last,
+                                   char sep, char quote, char escape,
+                                   Func &func) {
+  return for_each_unquoted_blocks(first, last, sep, quote, escape,
+                                  quote_masks_sse2, func);
+}
+
+template <class Func>
+__attribute__((target("avx2"))) inline bool
+for_each_unquoted_avx2(const char *first, const char *last, char sep,
+                       char quote, char escape, Func &func) {
+  return for_each_unquoted_blocks(first, last, sep, quote, escape,
+                                  quote_masks_avx2, func);
+}
+
+template <class Func>
+__attribute__((target("avx512bw"))) inline bool
+for_each_unquoted_avx512(const char *first, const char *last, char sep,
+                         char quote, char escape, Func &func) {
+  return for_each_unquoted_blocks(first, last, sep, quote, escape,
+                                  quote_masks_avx512, func);
+}
+
+#endif
+
+} // namespace Kernel
+
+// Function calls func(offset) for offset (from first) of every sep in
+// [first, last) lying outside quotes, in order. Each quote opens or closes
+// quotes, so doubled quotes inside quotes keep them open. Non-zero escape
+// makes the next character literal, which then neither toggles quotes nor
+// separates. Escape has to differ from sep and quote. Returns true if quotes
+// are left open.
+template <class Func>
+inline bool for_each_unquoted(const char *first, const char *last, char sep,
+                              char quote, char escape, Func func) {
+#ifdef AGIZMO_SIMD_X86
+  if (Cpu::get().avx512bw)
+    return Kernel::for_each_unquoted_avx512(first, last, sep, quote, escape,
+                                            func);
+  if (Cpu::get().avx2)
+    return Kernel::for_each_unquoted_avx2(first, last, sep, quote, escape,
+                                          func);
+  return Kernel::for_each_unquoted_sse2(first, last, sep, quote, escape, func);
+#else
+  return Kernel::for_each_unquoted_scalar(first, last, sep, quote, escape,
+                                          func);
+#endif
+}
+
+// Function appends offsets of separators found like by for_each_unquoted to
+// positions and returns true if quotes are left open.
+inline bool find_unquoted(const char *first, const char *last, char sep,
+                          char quote, char escape,
+                          std::vector<size_t> &positions) {
+  return for_each_unquoted(
+      first, last, sep, quote, escape,
+      [&positions](size_t pos) { positions.push_back(pos); });
+}
+
+namespace Kernel {
+
+// Lookup tables of UTF-8 validation algorithm by Keiser and Lemire
+// ("Validating UTF-8 In Less Than One Instruction Per Byte"). Every error
+// class has its own bit, error is found when bits of high and low nibble of
+// previous byte and high nibble of current byte overlap.
+struct Utf8Tables {
+  static constexpr uint8_t too_short{1 << 0};
+  static constexpr uint8_t too_long{1 << 1};
+  static constexpr uint8_t overlong_3{1 << 2};
+  static constexpr uint8_t too_large{1 << 3};
+  static constexpr uint8_t surrogate{1 << 4};
+  static constexpr uint8_t overlong_2{1 << 5};
+  static constexpr uint8_t too_large_1000{1 << 6};
+  static constexpr uint8_t overlong_4{1 << 6};
+  static constexpr uint8_t two_conts{1 << 7};
+  static constexpr uint8_t carry = too_short | too_long | two_conts;
+
+  static constexpr uint8_t first_high[16]{
+      too_long,  too_long,
+      too_long,  too_long,
+      too_long,  too_long,
+      too_long,  too_long,
+      two_conts, two_conts,
+      two_conts, two_conts,
+      too_short | overlong_2,
+      too_short,
+      too_short | overlong_3 | surrogate,
+      too_short | too_large | too_large_1000 | overlong_4};
+
+  static constexpr uint8_t first_low[16]{
+      carry | overlong_3 | overlong_2 | overlong_4,
+      carry | overlong_2,
+      carry,
+      carry,
+      carry | too_large,
+      carry | too_large | too_large_1000,
+      carry | too_large | too_large_1000,
+      carry | too_large | too_large_1000,
+      carry | too_large | too_large_1000,
+      carry | too_large | too_large_1000,
+      carry | too_large | too_large_1000,
+      carry | too_large | too_large_1000,
+      carry | too_large | too_large_1000,
+      carry | too_large | too_large_1000 | surrogate,
+      carry | too_large | too_large_1000,
+      carry | too_large | too_large_1000};
+
+  static constexpr uint8_t second_high[16]{
+      too_short,
+      too_short,
+      too_short,
+      too_short,
+      too_short,
+      too_short,
+      too_short,
+      too_short,
+      too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 |
+          overlong_4,
+      too_long | overlong_2 | two_conts | overlong_3 | too_large,
+      too_long | overlong_2 | two_conts | surrogate | too_large,
+      too_long | overlong_2 | two_conts | surrogate | too_large,
+      too_short,
+      too_short,
+      too_short,
+      too_short};
+};
+
+inline bool is_ascii_scalar(const char *first, const char *last) noexcept {
+  for (; first != last; ++first)
+    if (static_cast<unsigned char>(*first) >= 0x80)
+      return false;
+  return true;
+}
+
+inline bool validate_utf8_scalar(const char *first,
+                                 const char *last) noexcept {
+  const auto data = reinterpret_cast<const unsigned char *>(first);
+  const auto size = static_cast<size_t>(last - first);
+
+  for (size_t pos = 0; pos < size;) {
+    const auto lead = data[pos];
+    if (lead < 0x80) {
+      ++pos;
+      continue;
+    }
+
+    size_t length{0};
+    uint32_t code{0};
+    if (lead >= 0xc2 && lead <= 0xdf) {
+      length = 2;
+      code = lead & 0x1f;
+    } else if ((lead & 0xf0) == 0xe0) {
+      length = 3;
+      code = lead & 0x0f;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+      length = 4;
+      code = lead & 0x07;
+    } else
+      return false;
+
+    if (size - pos < length)
+      return false;
+    for (size_t i = 1; i < length; ++i) {
+      if ((data[pos + i] & 0xc0) != 0x80)
+        return false;
+      code = code << 6 | (data[pos + i] & 0x3f);
+    }
+
+    if ((length == 3 && (code < 0x800 || (code >= 0xd800 && code <= 0xdfff))) ||
+        (length == 4 && (code < 0x10000 || code > 0x10ffff)))
+      return false;
+
+    pos += length;
+  }
+
+  return true;
+}
+
+#ifdef AGIZMO_SIMD_X86
+
+inline bool is_ascii_sse2(const char *first, const char *last) noexcept {
+  auto bits = _mm_setzero_si128();
+  for (; last - first >= 16; first += 16)
+    bits = _mm_or_si128(
+        bits, _mm_loadu_si128(reinterpret_cast<const __m128i *>(first)));
+  return !_mm_movemask_epi8(bits) && is_ascii_scalar(first, last);
+}
+
+__attribute__((target("ssse3"))) inline __m128i
+utf8_block_error_ssse3(__m128i input, __m128i prev_input) noexcept {
+  using T = Utf8Tables;
+  const auto nibble = _mm_set1_epi8(0x0f);
+  const auto first_high =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(T::first_high));
+  const auto first_low =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(T::first_low));
+  const auto second_high =
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(T::second_high));
+
+  const auto prev1 = _mm_alignr_epi8(input, prev_input, 15);
+  const auto prev2 = _mm_alignr_epi8(input, prev_input, 14);
+  const auto prev3 = _mm_alignr_epi8(input, prev_input, 13);
+
+  const auto special = _mm_and_si128(
+      _mm_and_si128(
+          _mm_shuffle_epi8(first_high,
+                           _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+          _mm_shuffle_epi8(first_low, _mm_and_si128(prev1, nibble))),
+      _mm_shuffle_epi8(second_high,
+                       _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+
+  const auto must_continue = _mm_and_si128(
+      _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80)),
+                   _mm_subs_epu8(prev3, _mm_set1_epi8(0xf0 - 0x80))),
+      _mm_set1_epi8(static_cast<char>(0x80)));
+
+  return _mm_xor_si128(must_continue, special);
+}
+
+// State of validation carried between consecutive blocks. Blocks of ASCII
+// characters only check that no sequence was left unfinished.
+struct Utf8StateSsse3 {
+  __m128i error{};
+  __m128i prev_input{};
+  __m128i prev_incomplete{};
+
+  __attribute__((target("ssse3"))) void check(const char *block) noexcept {
+    // Non-zero for lead bytes of sequences not finished within the block.
+    const auto incomplete_limit =
+        _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                      static_cast<char>(0xf0 - 1), static_cast<char>(0xe0 - 1),
+                      static_cast<char>(0xc0 - 1));
+    const auto input =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+
+    if (!_mm_movemask_epi8(input)) {
+      error = _mm_or_si128(error, prev_incomplete);
+      return;
+    }
+    error = _mm_or_si128(error, utf8_block_error_ssse3(input, prev_input));
+    prev_incomplete = _mm_subs_epu8(input, incomplete_limit);
+    prev_input = input;
+  }
+};
+
+__attribute__((target("ssse3"))) inline bool
+validate_utf8_ssse3(const char *first, const char *last) noexcept {
+  Utf8StateSsse3 state{};
+
+  for (; last - first >= 16; first += 16)
+    state.check(first);
+
+  if (first != last) {
+    char tail[16]{};
+    std::memcpy(tail, first, static_cast<size_t>(last - first));
+    state.check(tail);
+  }
+
+  const auto error = _mm_or_si128(state.error, state.prev_incomplete);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) ==
+         0xffff;
+}
+
+__attribute__((target("avx2"))) inline __m256i
+utf8_block_error_avx2(__m256i input, __m256i prev_input) noexcept {
+  using T = Utf8Tables;
+  const auto nibble = _mm256_set1_epi8(0x0f);
+  const auto first_high = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(T::first_high)));
+  const auto first_low = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(T::first_low)));
+  const auto second_high = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i *>(T::second_high)));
+
+  // Bytes preceding input, crossing the boundary of 128-bit lanes.
+  const auto shifted = _mm256_permute2x128_si256(prev_input, input, 0x21);
+  const auto prev1 = _mm256_alignr_epi8(input, shifted, 15);
+  const auto prev2 = _mm256_alignr_epi8(input, shifted, 14);
+  const auto prev3 = _mm256_alignr_epi8(input, shifted, 13);
+
+  const auto special = _mm256_and_si256(
+      _mm256_and_si256(
+          _mm256_shuffle_epi8(
+              first_high,
+              _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+          _mm256_shuffle_epi8(first_low, _mm256_and_si256(prev1, nibble))),
+      _mm256_shuffle_epi8(second_high,
+                          _mm256_and_si256(_mm256_srli_epi16(input, 4),
+                                           nibble)));
+
+  const auto must_continue = _mm256_and_si256(
+      _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80)),
+                      _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xf0 - 0x80))),
+      _mm256_set1_epi8(static_cast<char>(0x80)));
+
+  return _mm256_xor_si256(must_continue, special);
+}
+
+struct Utf8StateAvx2 {
+  __m256i error{};
+  __m256i prev_input{};
+  __m256i prev_incomplete{};
+
+  __attribute__((target("avx2"))) void check(const char *block) noexcept {
+    const auto incomplete_limit = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xf0 - 1), static_cast<char>(0xe0 - 1),
+        static_cast<char>(0xc0 - 1));
+    const auto input =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+
+    if (!_mm256_movemask_epi8(input)) {
+      error = _mm256_or_si256(error, prev_incomplete);
+      return;
+    }
+    error = _mm256_or_si256(error, utf8_block_error_avx2(input, prev_input));
+    prev_incomplete = _mm256_subs_epu8(input, incomplete_limit);
+    prev_input = input;
+  }
+};
+
+__attribute__((target("avx2"))) inline bool
+validate_utf8_avx2(const char *first, const char *last) noexcept {
+  Utf8StateAvx2 state{};
+
+  for (; last - first >= 32; first += 32)
+    state.check(first);
+
+  if (first != last) {
+    char tail[32]{};
+    std::memcpy(tail, first, static_cast<size_t>(last - first));
+    state.check(tail);
+  }
+
+  const auto error = _mm256_or_si256(state.error, state.prev_incomplete);
+  return _mm256_testz_si256(error, error);
+}
+
+#endif
+
+} // namespace Kernel
+
+// Function checks if [first, last) holds only ASCII characters.
+inline bool is_ascii(const char *first, const char *last) noexcept {
+#ifdef AGIZMO_SIMD_X86
+  return Kernel::is_ascii_sse2(first, last);
+#else
+  return Kernel::is_ascii_scalar(first, last);
+#endif
+}
+
+// Function checks if [first, last) is valid UTF-8: no overlong forms,
+// surrogates, code points above U+10FFFF or truncated sequences.
+inline bool validate_utf8(const char *first, const char *last) noexcept {
+#ifdef AGIZMO_SIMD_X86
+  static const auto kernel =
+      Cpu::get().avx2    ? Kernel::validate_utf8_avx2
+      : Cpu::get().ssse3 ? Kernel::validate_utf8_ssse3
+                         : Kernel::validate_utf8_scalar;
+  return kernel(first, last);
+#else
+  return Kernel::validate_utf8_scalar(first, last);
+#endif
+}
+
+// Function decodes valid UTF-8 from [first, last) into output of 32-bit
+// characters (char32_t or wchar_t on Linux) and returns end of output.
+// Blocks of ASCII characters are only widened.
+template <class Char>
+Char *decode_utf8(const char *first, const char *last, Char *output) noexcept {
+  static_assert(sizeof(Char) == 4, "decode_utf8 requires 32-bit characters");
+
+  const auto data = reinterpret_cast<const unsigned char *>(first);
+  const auto size = static_cast<size_t>(last - first);
+
+  for (size_t pos = 0; pos < size;) {
+#ifdef AGIZMO_SIMD_X86
+    if (size - pos >= 16) {
+      const auto block =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+      if (!_mm_movemask_epi8(block)) {
+        const auto zero = _mm_setzero_si128();
+        const auto low = _mm_unpacklo_epi8(block, zero);
+        const auto high = _mm_unpackhi_epi8(block, zero);
+        const auto target = reinterpret_cast<__m128i *>(output);
+        _mm_storeu_si128(target, _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128(target + 1, _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128(target + 2, _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128(target + 3, _mm_unpackhi_epi16(high, zero));
+        output += 16;
+        pos += 16;
+        continue;
+      }
+    }
+#endif
+    const auto lead = data[pos];
+    if (lead < 0x80) {
+      *output++ = static_cast<Char>(lead);
+      ++pos;
+    } else if (lead < 0xe0) {
+      *output++ =
+          static_cast<Char>((lead & 0x1f) << 6 | (data[pos + 1] & 0x3f));
+      pos += 2;
+    } else if (lead < 0xf0) {
+      *output++ = static_cast<Char>((lead & 0x0f) << 12 |
+                                    (data[pos + 1] & 0x3f) << 6 |
+                                    (data[pos + 2] & 0x3f));
+      pos += 3;
+    } else {
+      *output++ = static_cast<Char>(
+          (lead & 0x07) << 18 | (data[pos + 1] & 0x3f) << 12 |
+          (data[pos + 2] & 0x3f) << 6 | (data[pos + 3] & 0x3f));
+      pos += 4;
+    }
+  }
+
+  return output;
+}
+
+} // namespace AGizmo::Simd
@@ -2,18 +2,28 @@
 
 #include <iostream>
 
+#include <array>
+#include <charconv>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <iomanip>
+#include <iterator>
+#include <limits>
 #include <map>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <type_traits>
 
 #include "basic.hpp"
+#include "simd.hpp"
 
 //#include <experimental/iterator>
 
@@ -34,39 +44,75 @@ using cseconds = std::chrono::seconds;
 
 namespace StringSearch {
 
+// Functions of StringSearch take views and never allocate. Counting starts
+// from pos position. If pos is string::npos it counts from the beginning of
+// the string. If pos is bigger than string size nothing is counted.
+inline std::string_view search_from(std::string_view source,
+                                    size_t pos) noexcept {
+  if (pos == string::npos)
+    return source;
+  return pos <= source.size() ? source.substr(pos) : std::string_view{};
+}
+
+// Function checks if string contains character at pos or later. Like with
+// std::string::find, nothing is found from string::npos.
+inline bool contains(std::string_view source, char query,
+                     size_t pos = 0) noexcept {
+  if (pos >= source.size())
+    return false;
+  const auto last = source.data() + source.size();
+  return Simd::find_byte(source.data() + pos, last, query) != last;
+}
+
 // Function counts all occurences of character in string.
-// Check starts from pos position. If pos is string::npos
-// it checks from the beginning of the string.
-// If pos is bigger than string size it returns 0.
-inline auto contains(const string &source, const char query, size_t pos = 0) {
-  return source.find(query, pos) != string::npos;
+inline long count_all(std::string_view source, char query,
+                      size_t pos = 0) noexcept {
+  source = search_from(source, pos);
+  return static_cast<long>(Simd::count_byte(
+      source.data(), source.data() + source.size(), query));
 }
 
-inline long count_all(const string &source, char query, size_t pos = 0) {
-  auto first = next(begin(source), (pos == string::npos) ? 0 : pos);
-  auto last = end(source);
+// Function counts all occurences of any character from queries in string.
+inline long count_any(std::string_view source, std::string_view queries,
+                      size_t pos = 0) noexcept {
+  source = search_from(source, pos);
+  const Simd::ByteSet set{queries.data(), queries.data() + queries.size()};
+  return static_cast<long>(
+      Simd::count_set(source.data(), source.data() + source.size(), set));
+}
 
-  if (first <= last)
-    return std::count(first, last, query);
-  else
-    return 0;
+// Function returns position of the first character from queries in string,
+// like std::string::find_first_of, or string::npos if there is none.
+inline size_t find_first_of(std::string_view source, std::string_view queries,
+                            size_t pos = 0) noexcept {
+  if (pos == string::npos || pos >= source.size())
+    return string::npos;
+  const Simd::ByteSet set{queries.data(), queries.data() + queries.size()};
+  const auto last = source.data() + source.size();
+  const auto found = Simd::find_set(source.data() + pos, last, set);
+  return found == last ? string::npos
+                       : static_cast<size_t>(found - source.data());
 }
 
-inline auto str_starts_with(const string &source, const string &query) {
+inline bool str_starts_with(std::string_view source,
+                            std::string_view query) noexcept {
   return query.size() <= source.size() &&
-         query == source.substr(0, query.size());
+         source.compare(0, query.size(), query) == 0;
 }
 
-inline auto str_starts_with(const string &source, const char query) {
+inline bool str_starts_with(std::string_view source,
+                            const char query) noexcept {
   return 1 <= source.size() && query == source.front();
 }
 
-inline auto str_ends_with(const string &source, const string &query) {
+inline bool str_ends_with(std::string_view source,
+                          std::string_view query) noexcept {
   return query.size() <= source.size() &&
-         query == source.substr(source.size() - query.size());
+         source.compare(source.size() - query.size(), query.size(), query) ==
+             0;
 }
 
-inline auto str_ends_with(const string &source, const char query) {
+inline bool str_ends_with(std::string_view source, const char query) noexcept {
   return 1 <= source.size() && query == source.back();
 }
 
@@ -90,15 +136,195 @@ inline bool is_integer(const string &query) noexcept {
   }
 }
 
+namespace Kernel {
+
+inline constexpr uint64_t swar_ones{0x0101010101010101};
+
+// Function loads 8 bytes in memory order, first byte being the lowest.
+inline uint64_t load_eight(const char *first) noexcept {
+  uint64_t chunk;
+  std::memcpy(&chunk, first, sizeof(chunk));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  chunk = __builtin_bswap64(chunk);
+#endif
+  return chunk;
+}
+
+// Function checks if all 8 bytes of chunk are digits: high nibbles have to
+// be 3 and adding 6 to low nibbles must not carry into them.
+inline bool eight_digits(uint64_t chunk) noexcept {
+  return ((chunk & swar_ones * 0xf0) |
+          ((chunk + swar_ones * 0x06) & swar_ones * 0xf0) >> 4) ==
+         swar_ones * 0x33;
+}
+
+// Function converts 8 digits at once, combining neighbouring digits, then
+// pairs and finally quadruples with multiplications.
+inline uint32_t parse_eight(uint64_t chunk) noexcept {
+  constexpr uint64_t mask{0x000000ff000000ff};
+  constexpr uint64_t mul_first{100 + (1000000ull << 32)};
+  constexpr uint64_t mul_second{1 + (10000ull << 32)};
+  chunk -= swar_ones * '0';
+  chunk = chunk * 10 + (chunk >> 8);
+  return static_cast<uint32_t>(
+      ((chunk & mask) * mul_first + ((chunk >> 16) & mask) * mul_second) >>
+      32);
+}
+
+// Function accumulates up to limit digits from pos, 8 at a time while
+// possible.
+inline uint64_t parse_digits(const char *&pos, const char *last,
+                             size_t limit) noexcept {
+  const auto stop = pos + std::min<size_t>(limit, last - pos);
+  uint64_t result{0};
+  while (stop - pos >= 8) {
+    const auto chunk = load_eight(pos);
+    if (!eight_digits(chunk))
+      break;
+    result = result * 100000000 + parse_eight(chunk);
+    pos += 8;
+  }
+  for (; pos != stop && static_cast<unsigned char>(*pos - '0') < 10; ++pos)
+    result = result * 10 + static_cast<unsigned>(*pos - '0');
+  return result;
+}
+
+inline bool is_digit(const char *pos, const char *last) noexcept {
+  return pos != last && static_cast<unsigned char>(*pos - '0') < 10;
+}
+
+template <class Type>
+std::from_chars_result parse_integer(const char *first, const char *last,
+                                     Type &value) noexcept {
+  using Unsigned = std::make_unsigned_t<Type>;
+  // Numbers of 19 digits always fit into uint64_t.
+  constexpr size_t limit{19};
+
+  auto pos = first;
+  bool negative{false};
+  if constexpr (std::is_signed_v<Type>)
+    if (pos != last && *pos == '-') {
+      negative = true;
+      ++pos;
+    }
+
+  const auto digits = pos;
+  const auto result = parse_digits(pos, last, limit);
+  if (pos == digits)
+    return {first, std::errc::invalid_argument};
+  if (is_digit(pos, last))
+    return std::from_chars(first, last, value);
+
+  const uint64_t maximum{
+      static_cast<Unsigned>(std::numeric_limits<Type>::max())};
+  if (result > maximum + negative)
+    return {pos, std::errc::result_out_of_range};
+
+  const auto magnitude = static_cast<Unsigned>(result);
+  value = static_cast<Type>(negative ? Unsigned{0} - magnitude : magnitude);
+  return {pos, std::errc{}};
+}
+
+// Decimals without exponent whose digits fit into 53 bits and that have at
+// most 22 fractional digits are divided by exact power of 10, which is
+// correctly rounded. Other numbers are left to from_chars.
+inline std::from_chars_result parse_double(const char *first, const char *last,
+                                           double &value) noexcept {
+  constexpr double powers[]{1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                            1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                            1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  constexpr size_t limit{19};
+
+  auto pos = first;
+  const bool negative{pos != last && *pos == '-'};
+  pos += negative;
+
+  const auto digits = pos;
+  auto mantissa = parse_digits(pos, last, limit);
+  size_t count = pos - digits;
+  size_t fraction{0};
+  if (count && pos != last && *pos == '.') {
+    const auto point = ++pos;
+    const auto low = parse_digits(pos, last, limit - count);
+    fraction = pos - point;
+    count += fraction;
+    mantissa = mantissa * static_cast<uint64_t>(powers[fraction]) + low;
+  }
+
+  if (!count || is_digit(pos, last) || mantissa >> 53 ||
+      (pos != last && (*pos == 'e' || *pos == 'E' || *pos == '.')))
+    return std::from_chars(first, last, value);
+
+  value = static_cast<double>(mantissa) / powers[fraction];
+  if (negative)
+    value = -value;
+  return {pos, std::errc{}};
+}
+
+} // namespace Kernel
+
+// Function parses number from the beginning of [first, last) like
+// std::from_chars, reporting errors in the result instead of exceptions.
+// Integers are parsed 8 digits at a time and simple decimals take a fast
+// path, other inputs are handed to std::from_chars.
+template <class Type>
+std::from_chars_result parse_number(const char *first, const char *last,
+                                    Type &value) noexcept {
+  static_assert(std::is_arithmetic_v<Type> && !std::is_same_v<Type, bool>,
+                "parse_number supports numbers only");
+  if constexpr (std::is_same_v<Type, double>)
+    return Kernel::parse_double(first, last, value);
+  else if constexpr (std::is_integral_v<Type> && sizeof(Type) <= 8)
+    return Kernel::parse_integer(first, last, value);
+  else
+    return std::from_chars(first, last, value);
+}
+
+// Function converts whole query to number. If query is not a valid number
+// or it is out of range of Type function returns nullopt.
+template <class Type>
+std::optional<Type> str_to_number(std::string_view query) noexcept {
+  Type result{};
+  const auto last = query.data() + query.size();
+  const auto [pos, error] = parse_number(query.data(), last, result);
+  if (error != std::errc{} || pos != last)
+    return nullopt;
+  return result;
+}
+
+// Function converts every field to number, storing them contiguously from
+// output. Returns index of the first invalid field, which is left as zero,
+// or number of fields if all of them are valid.
+template <class Type, class Fields>
+size_t str_to_numbers(const Fields &fields, Type *output) noexcept {
+  size_t index{0};
+  for (const auto &field : fields) {
+    const std::string_view query{field};
+    const auto last = query.data() + query.size();
+    const auto [pos, error] = parse_number(query.data(), last, *output);
+    if (error != std::errc{} || pos != last) {
+      *output = Type{};
+      return index;
+    }
+    ++output;
+    ++index;
+  }
+  return index;
+}
+
+template <class Type, class Fields>
+size_t str_to_numbers(const Fields &fields, vector<Type> &output) {
+  output.resize(std::size(fields));
+  return str_to_numbers(fields, output.data());
+}
+
 // Function checks if given strings is a valid number and converts it to
 // integer. If it is not a valid number function returns nullopt.
-inline opt_int str_to_int(const string &query, bool negative = false) {
-  if (negative && query.front() == '-' && only_digits(query.substr(1)))
-    return std::stoi(query);
-  else if (only_digits(query))
-    return std::stoi(query);
-  else
+inline opt_int str_to_int(std::string_view query,
+                          bool negative = false) noexcept {
+  if (!negative && !query.empty() && query.front() == '-')
     return nullopt;
+  return str_to_number<int>(query);
 }
 
 // Function converts time to string
@@ -119,71 +345,120 @@ template <typename Type> string str_time(std::chrono::duration<Type> time) {
 using std::abs;
 using std::log10;
 
-inline string str_double(double number, int step = 3, int precision = 0) {
-  sstream output;
+// Function checks if number is written by str_double in scientific notation,
+// which happens when decimal magnitude of its absolute value exceeds step.
+// Zero, infinities and NaN have no magnitude.
+inline bool str_double_scientific(double number, int step) noexcept {
+  const auto magnitude = abs(number);
+  return magnitude != 0 && std::isfinite(magnitude) &&
+         abs(log10(magnitude)) > step;
+}
 
+// Function writes number into [first, last) with std::to_chars and returns
+// its result, which holds std::errc::value_too_large if buffer is too short.
+// With non-zero step numbers of magnitude above step are written in
+// scientific notation with precision (3 by default) and others with step
+// significant digits. Without step number is written with fixed precision,
+// or in the shortest form that reads back to the same number.
+inline std::to_chars_result str_double_into(char *first, char *last,
+                                            double number, int step = 3,
+                                            int precision = 0) noexcept {
   if (step) {
-    if (const auto magnitude = log10(number); abs(magnitude) > step) {
-      output << std::scientific << std::setprecision(precision ? precision : 3)
-             << number;
-    } else
-      output << std::setprecision(step) << number;
-  } else {
-    if (precision)
-      output << std::fixed << std::setprecision(precision) << number;
-    else
-      output << std::setprecision(std::numeric_limits<double>::digits10 + 1)
-             << number;
+    if (str_double_scientific(number, step))
+      return std::to_chars(first, last, number, std::chars_format::scientific,
+                           precision ? precision : 3);
+    return std::to_chars(first, last, number, std::chars_format::general,
+                         step);
   }
+  if (precision)
+    return std::to_chars(first, last, number, std::chars_format::fixed,
+                         precision);
+  return std::to_chars(first, last, number);
+}
+
+// Function appends number formatted like str_double_into to output.
+inline void str_double_into(string &output, double number, int step = 3,
+                            int precision = 0) {
+  std::array<char, 128> buffer;
+  const auto [pos, error] = str_double_into(
+      buffer.data(), buffer.data() + buffer.size(), number, step, precision);
+  if (error == std::errc{}) {
+    output.append(buffer.data(), pos);
+    return;
+  }
+
+  // Fixed notation of large numbers, digits and exponent are bounded.
+  const auto size = output.size();
+  output.resize(size + std::numeric_limits<double>::max_exponent10 +
+                std::max(step, precision) + 8);
+  const auto result = str_double_into(output.data() + size,
+                                      output.data() + output.size(), number,
+                                      step, precision);
+  output.resize(result.ptr - output.data());
+}
+
+inline string str_double(double number, int step = 3, int precision = 0) {
+  string result;
+  str_double_into(result, number, step, precision);
+  return result;
+}
 
-  return output.str();
+// Set of characters stripped by str_clean, isspace characters of "C" locale
+// when strip is empty.
+inline Simd::ByteSet strip_set(std::string_view strip) {
+  if (strip.empty())
+    strip = " \t\n\v\f\r";
+  return Simd::ByteSet{strip.data(), strip.data() + strip.size()};
+}
+
+// Function returns view of source without leading and trailing characters
+// present in strip.
+inline std::string_view str_clean_ends_view(std::string_view source,
+                                            const Simd::ByteSet &strip) {
+  size_t first{0};
+  size_t last{source.size()};
+  while (first < last && strip.contains(source[first]))
+    ++first;
+  while (last > first && strip.contains(source[last - 1]))
+    --last;
+  return source.substr(first, last - first);
 }
 
 // Function cleans string's ends from whitespace characters.
 // It find first and last characters that are not whitespace and construct
 // string from iterators
 inline string str_clean_ends(const string &source, const char strip[]) {
-  // Find first character not present in strip array.
-  auto first = source.find_first_not_of(strip);
-  // If there are only whitespaces or source is empty return an empty string
-  if (string::npos == first)
-    return {};
-  // Find last character that is not in strip.
-  auto last = source.find_last_not_of(strip);
-  // Return subtring from first to last position
-  return source.substr(first, last - first + 1);
+  return string{str_clean_ends_view(
+      source, Simd::ByteSet{strip, strip + std::strlen(strip)})};
 }
 
 // Function cleans string's ends from whitespace characters.
 // It find first and last characters that are not whitespace and
 // substring from this positions.
 inline string str_clean_ends(const string &source, const string &strip = "") {
-  if (strip.size())
-    return str_clean_ends(source, strip.c_str());
+  return string{str_clean_ends_view(source, strip_set(strip))};
+}
 
-  auto first = find_if_not(source.begin(), source.end(),
-                           [](char c) { return isspace(c); });
-  if (source.end() == first)
-    return {};
-  auto last = find_if_not(source.rbegin(), source.rend(),
-                          [](char c) { return isspace(c); });
-  return string(first, last.base());
+// Function writes source cleaned in a single pass to output and returns its
+// size: ends are trimmed from characters in strip, then every character in
+// strip becomes space and runs of spaces are reduced to single ones. Output
+// needs size of source and may be equal to source.data().
+inline size_t str_clean_into(std::string_view source, Simd::ByteSet strip,
+                             bool ends, char *output) {
+  if (ends)
+    source = str_clean_ends_view(source, strip);
+  strip.insert(' ');
+  return Simd::collapse_bytes(source.data(), source.data() + source.size(),
+                              strip, output);
 }
 
 inline string str_clean(const string &source, const char strip[],
                         bool ends = true) {
-  string result{ends ? str_clean_ends(source, strip) : source};
-
-  auto found = result.find_first_of(strip);
-  while (string::npos != found) {
-    result.at(found) = ' ';
-    found = result.find_first_of(strip, found + 1);
-  }
-  auto first = result.begin();
-  auto last = unique(first, result.end(),
-                     [](char l, char r) { return (l == ' ' && r == ' '); });
-
-  return string(first, last);
+  string result(source.size(), '\0');
+  result.resize(str_clean_into(
+      source, Simd::ByteSet{strip, strip + std::strlen(strip)}, ends,
+      result.data()));
+  return result;
 }
 
 // Function cleans string from multiple whitespace characters.by converting
@@ -191,18 +466,16 @@ inline string str_clean(const string &source, const char strip[],
 // into single ones.
 inline string str_clean(const string &source, bool ends = true,
                         const string &strip = " \n") {
-  // If user defines collection of whitespaces overloaded function is called
-  if (!strip.empty())
-    return str_clean(source, strip.c_str(), ends);
+  string result(source.size(), '\0');
+  result.resize(str_clean_into(source, strip_set(strip), ends, result.data()));
+  return result;
+}
 
-  string result{ends ? str_clean_ends(source) : source};
-  auto first = result.begin();
-  auto last = result.end();
-  replace_if(
-      first, last, [](char c) { return isspace(c); }, ' ');
-  last = unique(first, result.end(),
-                [](char l, char r) { return (l == ' ' && r == ' '); });
-  return string(first, last);
+// Function cleans source like str_clean, but without allocation.
+inline void str_clean_in_place(string &source, bool ends = true,
+                               const string &strip = " \n") {
+  source.resize(
+      str_clean_into(source, strip_set(strip), ends, source.data()));
 }
 
 inline string str_align(const string &message, size_t width = 80,
@@ -289,37 +562,226 @@ inline string str_replace(string source, char query, char value) {
   return source;
 }
 
+// Function appends source with all occurences of query replaced by value to
+// output. Source is scanned once, candidates are found with SIMD prefilter
+// on first (and last) byte of query, so time is linear in size of source.
+inline void str_replace_into(std::string_view source, std::string_view query,
+                             std::string_view value, string &output) {
+  if (query.empty()) {
+    output.append(source);
+    return;
+  }
+
+  const auto last = source.data() + source.size();
+
+  for (auto pos = source.data();;) {
+    const auto found =
+        Simd::find_substring(pos, last, query.data(), query.size());
+    output.append(pos, static_cast<size_t>(found - pos));
+    if (found == last)
+      return;
+    output.append(value);
+    pos = found + query.size();
+  }
+}
+
 // Replaces all occurences of string query with string value in string source.
 inline string str_replace(string source, const string &query,
                           const string &value) {
-  if (auto query_size = static_cast<long>(query.size());
-      !source.size() || !query_size)
-    return source;
-  else if (auto value_size = value.size(); query.size() > 1 || value_size > 1) {
-    auto first = source.begin();
-    auto searcher = default_searcher(query.begin(), query.end());
-    auto found = search(first, source.end(), searcher);
-    auto visited = distance(first, found);
-
-    while (found != source.end()) {
-      visited += value_size;
-      source.replace(found, found + query_size, value);
-      first = next(source.begin(), visited);
-      found = search(first, source.end(), searcher);
-      visited += distance(first, found);
-    }
+  if (source.empty() || query.empty())
     return source;
-  } else if (value_size)
+  else if (query.size() == 1 && value.size() == 1)
     return str_replace(source, query[0], value[0]);
-  else
+  else if (query.size() == 1 && value.empty())
     return str_replace(source, query[0]);
+
+  string result{};
+  result.reserve(source.size());
+  str_replace_into(source, query, value, result);
+  return result;
 }
 
+// Multi-pattern replacer compiled once from pairs of pattern and value.
+// Aho-Corasick automaton with dense transitions over classes of bytes
+// present in patterns is built from reversed patterns, so reading source
+// backwards it gives the longest pattern starting at every position.
+// Overlapping matches are resolved leftmost-longest: match starting first
+// wins, the longest of matches starting at the same position is chosen.
+// Empty patterns are ignored, of repeated patterns the first one is used.
+// Rewriting takes linear time, see replace.
+class Replacer {
+private:
+  static constexpr uint32_t none{UINT32_MAX};
+
+  std::array<uint16_t, 256> classes{};
+  size_t width{1};
+  vector<uint32_t> transitions{};
+  // Longest reversed pattern ending in state, including these of its
+  // failure links.
+  vector<uint32_t> longest{};
+  vector<size_t> lengths{};
+  vector<string> values{};
+  size_t max_length{0};
+
+  uint32_t add_state() {
+    transitions.resize(transitions.size() + width, none);
+    longest.push_back(none);
+    return static_cast<uint32_t>(longest.size() - 1);
+  }
+
+  uint32_t &next(uint32_t state, unsigned char byte) {
+    return transitions[state * width + classes[byte]];
+  }
+
+  uint32_t next(uint32_t state, unsigned char byte) const {
+    return transitions[state * width + classes[byte]];
+  }
+
+  void build(const vector<std::pair<string, string>> &patterns) {
+    uint16_t count{1};
+    for (const auto &[pattern, value] : patterns)
+      for (const auto byte : pattern)
+        if (!classes[static_cast<unsigned char>(byte)])
+          classes[static_cast<unsigned char>(byte)] = count++;
+    width = count;
+
+    add_state();
+    for (const auto &[pattern, value] : patterns) {
+      if (pattern.empty())
+        continue;
+
+      uint32_t state{0};
+      for (auto byte = pattern.rbegin(); byte != pattern.rend(); ++byte) {
+        auto target = next(state, static_cast<unsigned char>(*byte));
+        if (target == none) {
+          target = add_state();
+          next(state, static_cast<unsigned char>(*byte)) = target;
+        }
+        state = target;
+      }
+
+      if (longest[state] == none) {
+        longest[state] = static_cast<uint32_t>(lengths.size());
+        lengths.push_back(pattern.size());
+        values.push_back(value);
+        max_length = std::max(max_length, pattern.size());
+      }
+    }
+
+    // Breadth first order visits failure target before the state, so
+    // missing transitions and longest matches are copied from it.
+    vector<uint32_t> fail(longest.size(), 0);
+    std::deque<uint32_t> queue{};
+    for (size_t c = 0; c < width; ++c) {
+      auto &target = transitions[c];
+      if (target == none)
+        target = 0;
+      else
+        queue.push_back(target);
+    }
+
+    while (!queue.empty()) {
+      const auto state = queue.front();
+      queue.pop_front();
+      if (longest[state] == none)
+        longest[state] = longest[fail[state]];
+
+      for (size_t c = 0; c < width; ++c) {
+        auto &target = transitions[state * width + c];
+        const auto fallback = transitions[fail[state] * width + c];
+        if (target == none)
+          target = fallback;
+        else {
+          fail[target] = fallback;
+          queue.push_back(target);
+        }
+      }
+    }
+  }
+
+public:
+  Replacer() { build({}); }
+
+  template <typename T, typename = std::enable_if_t<
+                            !std::is_same_v<std::decay_t<T>, Replacer>>>
+  Replacer(const T &index) {
+    vector<std::pair<string, string>> patterns{};
+    for (const auto &[pattern, value] : index)
+      patterns.emplace_back(pattern, value);
+    build(patterns);
+  }
+
+  // Function returns number of distinct patterns.
+  size_t size() const noexcept { return lengths.size(); }
+
+  // Function writes source with patterns replaced into output, which is
+  // cleared first, so its buffer can be reused between calls.
+  // Source is processed in blocks: longest pattern starting at every
+  // position of block is found reading it backwards, starting m - 1 bytes
+  // past its end (m being the length of the longest pattern), then matches
+  // are committed left to right. Blocks hold at least m positions, so every
+  // byte is read at most three times.
+  void replace(std::string_view source, string &output) const {
+    output.clear();
+    if (!max_length) {
+      output.assign(source);
+      return;
+    }
+
+    std::array<uint32_t, 1024> local;
+    vector<uint32_t> heap{};
+    auto starts = local.data();
+    auto block = local.size();
+    if (max_length > block) {
+      heap.resize(max_length);
+      starts = heap.data();
+      block = max_length;
+    }
+
+    size_t copied{0};
+    for (size_t first = 0; first < source.size(); first += block) {
+      const auto last = std::min(source.size(), first + block);
+      const auto from = std::max(first, copied);
+      if (from >= last)
+        continue;
+
+      uint32_t state{0};
+      for (auto pos = std::min(source.size(), last + max_length - 1);
+           pos > from;) {
+        --pos;
+        state = next(state, static_cast<unsigned char>(source[pos]));
+        if (pos < last)
+          starts[pos - first] = longest[state];
+      }
+
+      for (auto pos = from; pos < last;) {
+        const auto found = starts[pos - first];
+        if (found == none) {
+          ++pos;
+          continue;
+        }
+        output.append(source, copied, pos - copied);
+        output.append(values[found]);
+        copied = pos += lengths[found];
+      }
+    }
+
+    output.append(source, copied);
+  }
+
+  string replace(std::string_view source) const {
+    string result{};
+    result.reserve(source.size());
+    replace(source, result);
+    return result;
+  }
+};
+
+// Function replaces all patterns of index (pairs of pattern and value) in
+// linear time, see Replacer. Build Replacer once to process many strings.
 template <typename T>
-inline string str_replace_n(string source, const T &index) {
-  for (const auto &[ele, value] : index)
-    str_replace(source, ele, value);
-  return source;
+inline string str_replace_n(const string &source, const T &index) {
+  return Replacer{index}.replace(source);
 }
 
 inline string str_reverse(string result) {
@@ -364,17 +826,182 @@ namespace StringCompose {
 //#include <experimental/iterator>
 // using std::experimental::ostream_joiner;
 
+// Output buffer building a string in place. Text is appended directly and
+// numbers are written with std::to_chars, so no temporary strings or
+// streams are created. Operator << mirrors std::ostream formatting, also
+// signed and unsigned char are written as characters, and falls back to
+// std::ostream for types the builder does not know.
+class StringBuilder {
+private:
+  string buffer{};
+
+  template <class Type>
+  static constexpr bool is_text_v =
+      std::is_convertible_v<const Type &, std::string_view>;
+
+  template <class Type>
+  static constexpr bool is_char_v = std::is_same_v<Type, char> ||
+                                    std::is_same_v<Type, signed char> ||
+                                    std::is_same_v<Type, unsigned char>;
+
+  template <class Type>
+  static constexpr bool is_integer_v =
+      std::is_integral_v<Type> && !std::is_same_v<Type, bool> &&
+      !is_char_v<Type>;
+
+  // Function writes number with to_chars through a local buffer, so reserved
+  // capacity is never exceeded by a guess of its length. Longer numbers are
+  // written straight into buffer grown until they fit.
+  template <class... Args> void write(Args... args) {
+    std::array<char, 32> digits;
+    const auto [last, error] =
+        std::to_chars(digits.data(), digits.data() + digits.size(), args...);
+    if (error == std::errc{}) {
+      buffer.append(digits.data(), last);
+      return;
+    }
+
+    const auto size = buffer.size();
+    for (auto extra = 2 * digits.size();; extra *= 2) {
+      buffer.resize(size + extra);
+      const auto result = std::to_chars(buffer.data() + size,
+                                        buffer.data() + buffer.size(), args...);
+      if (result.ec == std::errc{}) {
+        buffer.resize(static_cast<size_t>(result.ptr - buffer.data()));
+        return;
+      }
+    }
+  }
+
+public:
+  StringBuilder() = default;
+  explicit StringBuilder(size_t capacity) { buffer.reserve(capacity); }
+
+  // Function returns number of characters item takes when appended, exact
+  // for text and integers, or 0 when it is not known in advance.
+  template <class Type> static size_t length(const Type &item) noexcept {
+    if constexpr (is_text_v<Type>)
+      return std::string_view{item}.size();
+    else if constexpr (is_char_v<Type>)
+      return 1;
+    else if constexpr (is_integer_v<Type>) {
+      size_t result{1};
+      auto value = item;
+      if constexpr (std::is_signed_v<Type>)
+        result += value < 0;
+      while (value /= 10)
+        ++result;
+      return result;
+    } else
+      return 0;
+  }
+
+  void reserve(size_t capacity) { buffer.reserve(capacity); }
+  void clear() noexcept { buffer.clear(); }
+  size_t size() const noexcept { return buffer.size(); }
+  bool empty() const noexcept { return buffer.empty(); }
+
+  std::string_view view() const noexcept { return buffer; }
+  const string &str() const &noexcept { return buffer; }
+  string str() && noexcept { return std::move(buffer); }
+
+  StringBuilder &append(std::string_view text) {
+    buffer.append(text);
+    return *this;
+  }
+
+  StringBuilder &append(char symbol, size_t count = 1) {
+    buffer.append(count, symbol);
+    return *this;
+  }
+
+  template <class Type, std::enable_if_t<is_integer_v<Type>, int> = 0>
+  StringBuilder &append(Type number) {
+    write(number);
+    return *this;
+  }
+
+  // Number is padded from left with fill up to width characters.
+  template <class Type, std::enable_if_t<is_integer_v<Type>, int> = 0>
+  StringBuilder &append(Type number, size_t width, char fill = '0') {
+    if (const auto size = length(number); size < width)
+      buffer.append(width - size, fill);
+    return append(number);
+  }
+
+  // Number is formatted like StringFormat::str_double.
+  StringBuilder &append(double number, int step, int precision = 0) {
+    StringFormat::str_double_into(buffer, number, step, precision);
+    return *this;
+  }
+
+  // Text is enclosed in delim, with delim and escape preceded by escape,
+  // like std::quoted does.
+  StringBuilder &appendQuoted(std::string_view text, char delim = '"',
+                              char escape = '\\') {
+    buffer.reserve(buffer.size() + text.size() + 2);
+    buffer.push_back(delim);
+    for (const auto symbol : text) {
+      if (symbol == delim || symbol == escape)
+        buffer.push_back(escape);
+      buffer.push_back(symbol);
+    }
+    buffer.push_back(delim);
+    return *this;
+  }
+
+  template <class Type> StringBuilder &operator<<(const Type &item) {
+    if constexpr (is_text_v<Type>)
+      return append(std::string_view{item});
+    else if constexpr (is_char_v<Type>)
+      return append(static_cast<char>(item));
+    else if constexpr (is_integer_v<Type>)
+      return append(item);
+    else if constexpr (std::is_floating_point_v<Type>) {
+      // Default precision of std::ostream.
+      write(item, std::chars_format::general, 6);
+      return *this;
+    } else {
+      sstream output;
+      output << item;
+      return append(output.str());
+    }
+  }
+
+  friend std::ostream &operator<<(std::ostream &stream,
+                                  const StringBuilder &item) {
+    return stream << item.view();
+  }
+};
+
+// Function returns number of characters of joined items, each of them taking
+// extra characters more, if iterators can be traversed twice, otherwise 0.
+// Items of unknown length are counted as extra only.
+template <typename It>
+size_t str_join_length(It begin, It end, std::string_view sep,
+                       size_t extra = 0) {
+  using Category = typename std::iterator_traits<It>::iterator_category;
+  if constexpr (!std::is_base_of_v<std::forward_iterator_tag, Category>)
+    return 0;
+  else {
+    size_t result{0};
+    size_t count{0};
+    for (; begin != end; ++begin, ++count)
+      result += StringBuilder::length(*begin) + extra;
+    return result + (count ? count - 1 : 0) * sep.size();
+  }
+}
+
 template <typename It> string str_join(It begin, It end, string sep = "\t") {
   if (begin == end)
     return "";
 
-  sstream output;
+  StringBuilder output{str_join_length(begin, end, sep)};
   output << *begin;
   for_each(next(begin), end,
-           [&output, sep](const auto &ele) { output << sep << ele; });
-  //  copy(begin, end, ostream_joiner(output, sep));
+           [&output, &sep](const auto &ele) { output << sep << ele; });
 
-  return output.str();
+  return std::move(output).str();
 }
 
 template <typename It> string str_join(It begin, It end, char sep) {
@@ -396,12 +1023,13 @@ string str_join_quoted(It begin, It end, string sep = "\t") {
   if (begin == end)
     return "";
 
-  sstream output;
-  output << quoted(*begin);
-  for_each(next(begin), end,
-           [&output, sep](const auto &ele) { output << sep << quoted(ele); });
+  StringBuilder output{str_join_length(begin, end, sep, 2)};
+  output.appendQuoted(*begin);
+  for_each(next(begin), end, [&output, &sep](const auto &ele) {
+    output.append(sep).appendQuoted(ele);
+  });
 
-  return output.str();
+  return std::move(output).str();
 }
 
 template <typename It> string str_join_quoted(It begin, It end, char sep) {
@@ -418,28 +1046,24 @@ string str_join_quoted(const Container &container, char sep) {
   return str_join_quoted(container.begin(), container.end(), string(1, sep));
 }
 
+// Function joins key and value pairs into "key=value;key=value", leaving
+// out values that are empty optionals.
 template <class InputIt>
 inline string str_join_fields(InputIt first, const InputIt &last,
                               string fields_sep = ";",
                               string values_sep = "=") {
-  if (first == last)
-    return "";
+  StringBuilder output;
 
-  sstream output;
-
-  for (; first != last; ++first) {
+  for (bool front = true; first != last; ++first, front = false) {
     const auto &[key, value] = *first;
-    output << fields_sep << key;
+    if (!front)
+      output << fields_sep;
+    output << key;
     if (value)
       output << values_sep << *value;
   }
 
-  string result;
-
-  output.get();
-  output >> result;
-
-  return result;
+  return std::move(output).str();
 }
 
 template <class MapType>
@@ -448,29 +1072,24 @@ inline string str_join_fields(const MapType &values, string fields_sep = ";",
   return str_join_fields(values.begin(), values.end(), fields_sep, values_sep);
 }
 
+// Function joins key and value pairs like str_join_fields, leaving out
+// values equal to missing.
 template <class Missing, class InputIt>
 inline string str_join_fields(Missing missing, InputIt first,
                               const InputIt &last, string fields_sep = ";",
                               string values_sep = "=") {
-  if (first == last)
-    return "";
-
-  sstream output;
+  StringBuilder output;
 
-  for (; first != last; ++first) {
+  for (bool front = true; first != last; ++first, front = false) {
     const auto &[key, value] = *first;
-    output << fields_sep << key;
+    if (!front)
+      output << fields_sep;
+    output << key;
     if (value != missing)
       output << values_sep << value;
   }
 
-  string result;
-
-  output.get();
-
-  output >> result;
-
-  return result;
+  return std::move(output).str();
 }
 
 // template <typename Value = opt_str, typename Map, typename It>
@@ -505,60 +1124,523 @@ namespace StringDecompose {
 using Basic::segment;
 using Basic::split;
 
+// Function returns positions of every sep in source, found in one pass
+// with SIMD kernel. Field i spans from position i - 1 (or -1) plus one to
+// position i (or source.size()).
+inline vector<size_t> str_split_offsets(std::string_view source, char sep) {
+  vector<size_t> result{};
+  Simd::find_all_byte(source.data(), source.data() + source.size(), sep,
+                      result);
+  return result;
+}
+
+// Fields are emitted straight into result while separators are found with
+// Simd::for_each_byte, result is reserved with Simd::count_byte.
 inline vec_str str_split(const string &source, char sep, bool empty) {
   if (!source.size())
     return vec_str{};
 
-  vec_str result{};
+  const auto first = source.data();
+  const auto last = first + source.size();
 
-  split<string>(source.begin(), source.end(), sep, back_inserter(result));
+  vec_str result{};
+  result.reserve(Simd::count_byte(first, last, sep) + 1);
+  size_t start{0};
+  Simd::for_each_byte(first, last, sep, [&](size_t pos) {
+                        if (empty || pos != start)
+                          result.emplace_back(source, start, pos - start);
+                        start = pos + 1;
+                      });
+  if (empty || start != source.size())
+    result.emplace_back(source, start);
 
-  if (!empty)
-    result.erase(remove(begin(result), end(result), ""), end(result));
+  return result;
+}
 
+// Function returns positions of every sep in source lying outside quotes,
+// found in one pass over masks of quotes (see Simd::find_unquoted). Non-zero
+// escape makes next character literal. Throws if quotes are left open.
+inline vector<size_t> str_split_quoted_offsets(std::string_view source,
+                                               char sep, char quote = '"',
+                                               char escape = 0) {
+  vector<size_t> result{};
+  if (Simd::find_unquoted(source.data(), source.data() + source.size(), sep,
+                          quote, escape, result))
+    throw runtime_error{"Unclosed quotation in '" + string(source) + "'"};
   return result;
 }
 
-inline vec_str str_split_quoted(const string &source, char sep, char quote) {
+// Function splits source on sep outside quotes. Fields keep their quotes and
+// empty fields are kept, also within quotes.
+inline vec_str str_split_quoted(const string &source, char sep, char quote,
+                                char escape = 0) {
   if (!source.size())
     return vec_str{};
 
-  vec_str output{};
-  string temp{};
-  for (const auto &ele : str_split(source, sep, true)) {
-    // Debug
-    //    std::cerr << "temp.empty(): " << temp.empty() << "\n"
-    //              << "count: " << StringSearch::count_all(ele, quote) << "\n"
-    //              << ele << "\n";
-    if (ele.empty()) {
-      if (temp.empty())
-        output.emplace_back(ele);
-      else
-        temp + sep + sep;
-    } else {
-      if (temp.empty()) {
-        if (StringSearch::count_all(ele, quote) % 2 == 0)
-          output.emplace_back(ele);
-        else
-          temp = ele;
-      } else {
-        if (auto count = StringSearch::count_all(ele, quote); !count)
-          temp += sep + ele;
-        else if (count % 2 == 0)
-          throw runtime_error{
-              source + "\n\n includes unclosed quatiotation in \n\n" + ele};
-        else {
-          output.emplace_back(temp + ele);
-          temp = "";
-        }
+  const auto offsets = str_split_quoted_offsets(source, sep, quote, escape);
+
+  vec_str result{};
+  result.reserve(offsets.size() + 1);
+
+  size_t start{0};
+  for (const auto pos : offsets) {
+    result.emplace_back(source, start, pos - start);
+    start = pos + 1;
+  }
+  result.emplace_back(source, start);
+
+  return result;
+}
+
+// Function stores fields of source with store(index, field), separators are
+// found with find(pos) returning position of next one or string_view::npos.
+// At most limit fields are stored, the last one holds the rest of source.
+// Returns number of stored fields.
+template <class Find, class Store>
+inline size_t split_view(std::string_view source, Find find, size_t sep_size,
+                         bool empty, size_t limit, Store store) {
+  size_t count{0};
+  size_t start{0};
+
+  while (count < limit) {
+    const auto found =
+        count + 1 == limit ? std::string_view::npos : find(start);
+    if (found == std::string_view::npos) {
+      if (empty || start != source.size())
+        store(count++, source.substr(start));
+      break;
+    }
+    if (empty || found != start)
+      store(count++, source.substr(start, found - start));
+    start = found + sep_size;
+  }
+
+  return count;
+}
+
+// Finders of the next separator in source starting from pos, used by
+// split_view and SplitRange. Return string_view::npos when there is none.
+struct FindSepChar {
+  std::string_view source{};
+  char sep{'\t'};
+
+  size_t operator()(size_t pos) const noexcept {
+    const auto last = source.data() + source.size();
+    const auto found = Simd::find_byte(source.data() + pos, last, sep);
+    return found == last ? std::string_view::npos
+                         : static_cast<size_t>(found - source.data());
+  }
+};
+
+// Empty separator is never found, so source is a single field.
+struct FindSepString {
+  std::string_view source{};
+  std::string_view sep{};
+
+  size_t operator()(size_t pos) const noexcept {
+    return sep.empty() ? std::string_view::npos : source.find(sep, pos);
+  }
+};
+
+// Separators between quote characters are skipped, quotes are kept.
+struct FindSepQuoted {
+  std::string_view source{};
+  char sep{','};
+  char quote{'"'};
+  char escape{0};
+
+  size_t operator()(size_t pos) const {
+    bool quoted{false};
+    for (; pos < source.size(); ++pos) {
+      if (escape && source[pos] == escape)
+        ++pos;
+      else if (source[pos] == quote)
+        quoted = !quoted;
+      else if (source[pos] == sep && !quoted)
+        return pos;
+    }
+    if (quoted)
+      throw runtime_error{"Unclosed quotation in '" + string(source) + "'"};
+    return std::string_view::npos;
+  }
+};
+
+inline FindSepChar find_sep_view(std::string_view source, char sep) {
+  return {source, sep};
+}
+
+inline FindSepString find_sep_view(std::string_view source,
+                                   std::string_view sep) {
+  return {source, sep};
+}
+
+inline FindSepQuoted find_sep_view(std::string_view source, char sep,
+                                   char quote, char escape = 0) {
+  return {source, sep, quote, escape};
+}
+
+// Functions str_split_view split source into views of its fields, valid as
+// long as source. Fields are stored in caller provided vector (cleared
+// first) or array, so buffers can be reused without allocations. Array
+// receives at most its size fields, the last one holding the rest of
+// source. Functions return number of fields.
+inline size_t str_split_view(std::string_view source, char sep,
+                             vector<std::string_view> &output,
+                             bool empty = true) {
+  output.clear();
+  if (source.empty())
+    return 0;
+
+  return split_view(source, find_sep_view(source, sep), 1, empty,
+                    string::npos, [&output](size_t, std::string_view field) {
+                      output.push_back(field);
+                    });
+}
+
+template <size_t Size>
+inline size_t str_split_view(std::string_view source, char sep,
+                             std::array<std::string_view, Size> &output,
+                             bool empty = true) {
+  if (source.empty())
+    return 0;
+
+  return split_view(source, find_sep_view(source, sep), 1, empty, Size,
+                    [&output](size_t index, std::string_view field) {
+                      output[index] = field;
+                    });
+}
+
+inline size_t str_split_view(std::string_view source, std::string_view sep,
+                             vector<std::string_view> &output,
+                             bool empty = true) {
+  output.clear();
+  if (sep.empty() || source.empty()) {
+    output.push_back(source);
+    return 1;
+  }
+
+  return split_view(source, find_sep_view(source, sep), sep.size(), empty,
+                    string::npos, [&output](size_t, std::string_view field) {
+                      output.push_back(field);
+                    });
+}
+
+template <size_t Size>
+inline size_t str_split_view(std::string_view source, std::string_view sep,
+                             std::array<std::string_view, Size> &output,
+                             bool empty = true) {
+  if (!Size)
+    return 0;
+  if (sep.empty() || source.empty()) {
+    output[0] = source;
+    return 1;
+  }
+
+  return split_view(source, find_sep_view(source, sep), sep.size(), empty,
+                    Size, [&output](size_t index, std::string_view field) {
+                      output[index] = field;
+                    });
+}
+
+// Quoted fields are split in one pass over the whole source, stored like by
+// split_view as Simd::for_each_unquoted finds separators, so nothing is
+// allocated. Throws if quotes are left open anywhere in source.
+template <class Store>
+inline size_t split_quoted_view(std::string_view source, char sep, char quote,
+                                char escape, bool empty, size_t limit,
+                                Store store) {
+  size_t count{0};
+  size_t start{0};
+  const auto first = source.data();
+  const auto open = Simd::for_each_unquoted(
+      first, first + source.size(), sep, quote, escape, [&](size_t pos) {
+        // The last field holds the rest of source.
+        if (count + 1 >= limit)
+          return;
+        if (empty || pos != start)
+          store(count++, source.substr(start, pos - start));
+        start = pos + 1;
+      });
+  if (open)
+    throw runtime_error{"Unclosed quotation in '" + string(source) + "'"};
+
+  if (count < limit && (empty || start != source.size()))
+    store(count++, source.substr(start));
+  return count;
+}
+
+inline size_t str_split_view(std::string_view source, char sep, char quote,
+                             vector<std::string_view> &output,
+                             bool empty = true, char escape = 0) {
+  output.clear();
+  if (source.empty())
+    return 0;
+
+  return split_quoted_view(source, sep, quote, escape, empty, string::npos,
+                           [&output](size_t, std::string_view field) {
+                             output.push_back(field);
+                           });
+}
+
+template <size_t Size>
+inline size_t str_split_view(std::string_view source, char sep, char quote,
+                             std::array<std::string_view, Size> &output,
+                             bool empty = true, char escape = 0) {
+  if (source.empty())
+    return 0;
+
+  return split_quoted_view(source, sep, quote, escape, empty, Size,
+                           [&output](size_t index, std::string_view field) {
+                             output[index] = field;
+                           });
+}
+
+inline vector<std::string_view> str_split_view(std::string_view source,
+                                               char sep, bool empty = true) {
+  vector<std::string_view> result{};
+  str_split_view(source, sep, result, empty);
+  return result;
+}
+
+inline vector<std::string_view> str_split_view(std::string_view source,
+                                               std::string_view sep,
+                                               bool empty = true) {
+  vector<std::string_view> result{};
+  str_split_view(source, sep, result, empty);
+  return result;
+}
+
+inline vector<std::string_view> str_split_view(std::string_view source,
+                                               char sep, char quote,
+                                               char escape = 0) {
+  vector<std::string_view> result{};
+  str_split_view(source, sep, quote, result, true, escape);
+  return result;
+}
+
+// Lazy forward range over fields of source. Next separator is searched only
+// when iterator is advanced, so breaking out of the loop early skips the rest
+// of source. Iterators are self-contained and never allocate, views are valid
+// as long as source.
+template <class Find> class SplitRange {
+private:
+  Find find{};
+  size_t sep_size{1};
+  bool empty_source{false};
+
+public:
+  class iterator {
+  private:
+    Find find{};
+    size_t sep_size{1};
+    size_t start{std::string_view::npos};
+    size_t stop{std::string_view::npos};
+    std::string_view field{};
+
+    void locate() {
+      stop = find(start);
+      field = find.source.substr(
+          start, stop == std::string_view::npos ? stop : stop - start);
+    }
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view *;
+    using reference = const std::string_view &;
+
+    iterator() = default;
+    iterator(const Find &find, size_t sep_size, size_t start)
+        : find{find}, sep_size{sep_size}, start{start} {
+      if (start != std::string_view::npos)
+        locate();
+    }
+
+    reference operator*() const noexcept { return field; }
+    pointer operator->() const noexcept { return &field; }
+
+    iterator &operator++() {
+      if (stop == std::string_view::npos)
+        start = std::string_view::npos;
+      else {
+        start = stop + sep_size;
+        locate();
       }
+      return *this;
     }
+
+    iterator operator++(int) {
+      auto result = *this;
+      ++*this;
+      return result;
+    }
+
+    // Offset of the current field in source.
+    size_t position() const noexcept { return start; }
+
+    bool operator==(const iterator &other) const noexcept {
+      return start == other.start;
+    }
+    bool operator!=(const iterator &other) const noexcept {
+      return !(*this == other);
+    }
+  };
+
+  SplitRange() = default;
+  SplitRange(Find find, size_t sep_size, bool empty_source)
+      : find{find}, sep_size{sep_size}, empty_source{empty_source} {}
+
+  iterator begin() const {
+    if (find.source.empty() && !empty_source)
+      return end();
+    return {find, sep_size, 0};
+  }
+  iterator end() const { return {find, sep_size, std::string_view::npos}; }
+};
+
+// Functions split_range follow str_split_view: empty source has no fields
+// with char separators and single empty field with string separator.
+inline SplitRange<FindSepChar> split_range(std::string_view source,
+                                           char sep) {
+  return {find_sep_view(source, sep), 1, false};
+}
+
+inline SplitRange<FindSepString> split_range(std::string_view source,
+                                             std::string_view sep) {
+  return {find_sep_view(source, sep), sep.size(), true};
+}
+
+inline SplitRange<FindSepQuoted> split_range(std::string_view source,
+                                             char sep, char quote,
+                                             char escape = 0) {
+  return {find_sep_view(source, sep, quote, escape), 1, false};
+}
+
+class Splitter;
+
+struct FindSepSplitter {
+  std::string_view source{};
+  const Splitter *splitter{nullptr};
+
+  size_t operator()(size_t pos) const noexcept;
+};
+
+// Separator compiled once and reused for splitting any number of inputs.
+// Search method depends on separator length: single character is found with
+// Simd::find_byte, short separators with SIMD filtering of their first and
+// last byte, longer ones with Boyer-Moore-Horspool skip table built here and
+// very long ones with memmem (Two-Way in glibc, linear in the worst case).
+// Copies share compiled state.
+class Splitter {
+public:
+  enum class Method { Whole, Byte, Filter, Horspool, TwoWay };
+
+  static constexpr size_t filter_limit{32};
+  static constexpr size_t horspool_limit{256};
+
+private:
+  std::shared_ptr<const string> sep{};
+  std::shared_ptr<const bmhs<const char *>> horspool{};
+  Method method{Method::Whole};
+
+public:
+  Splitter(string sep) : sep{std::make_shared<const string>(std::move(sep))} {
+    const auto size = this->sep->size();
+    if (!size)
+      method = Method::Whole;
+    else if (size == 1)
+      method = Method::Byte;
+    else if (size <= filter_limit)
+      method = Method::Filter;
+    else if (size <= horspool_limit) {
+      method = Method::Horspool;
+      horspool = std::make_shared<const bmhs<const char *>>(
+          this->sep->data(), this->sep->data() + size);
+    } else
+      method = Method::TwoWay;
+  }
+
+  const string &getSep() const noexcept { return *sep; }
+  Method getMethod() const noexcept { return method; }
+
+  // Function returns position of separator in source starting from pos, or
+  // string_view::npos if there is none.
+  size_t find(std::string_view source, size_t pos = 0) const noexcept {
+    if (pos > source.size())
+      return std::string_view::npos;
+
+    const auto first = source.data() + pos;
+    const auto last = source.data() + source.size();
+    const char *found{last};
+
+    switch (method) {
+    case Method::Whole:
+      return std::string_view::npos;
+    case Method::Byte:
+      found = Simd::find_byte(first, last, sep->front());
+      break;
+    case Method::Filter:
+      found = Simd::find_substring(first, last, sep->data(), sep->size());
+      break;
+    case Method::Horspool:
+      found = std::search(first, last, *horspool);
+      break;
+    case Method::TwoWay:
+      found = Simd::Kernel::find_substring_scalar(first, last, sep->data(),
+                                                  sep->size());
+      break;
+    }
+
+    return found == last ? std::string_view::npos
+                         : static_cast<size_t>(found - source.data());
+  }
+
+  // Functions split follow str_split with string separator: empty source
+  // or separator gives single field.
+  vec_str split(const string &source, bool empty = true) const {
+    vec_str result{};
+    if (method == Method::Whole || source.empty()) {
+      result.push_back(source);
+      return result;
+    }
+
+    split_view(source, FindSepSplitter{source, this}, sep->size(), empty,
+               string::npos, [&result](size_t, std::string_view field) {
+                 result.emplace_back(field);
+               });
+    return result;
+  }
+
+  size_t split(std::string_view source, vector<std::string_view> &output,
+               bool empty = true) const {
+    output.clear();
+    return split_view(source, FindSepSplitter{source, this},
+                      std::max<size_t>(sep->size(), 1), empty, string::npos,
+                      [&output](size_t, std::string_view field) {
+                        output.push_back(field);
+                      });
   }
 
-  if (!temp.empty())
-    throw runtime_error{"'" + temp + "' is not empty '" + "' "};
+  template <size_t Size>
+  size_t split(std::string_view source,
+               std::array<std::string_view, Size> &output,
+               bool empty = true) const {
+    return split_view(source, FindSepSplitter{source, this},
+                      std::max<size_t>(sep->size(), 1), empty, Size,
+                      [&output](size_t index, std::string_view field) {
+                        output[index] = field;
+                      });
+  }
+
+  // Lazy range over fields of source, valid as long as splitter and source.
+  SplitRange<FindSepSplitter> range(std::string_view source) const {
+    return {FindSepSplitter{source, this}, sep->size(), true};
+  }
+};
 
-  return output;
+inline size_t FindSepSplitter::operator()(size_t pos) const noexcept {
+  return splitter->find(source, pos);
 }
 
 inline vec_str str_split(const string &source, string sep = "\t",
@@ -569,19 +1651,7 @@ inline vec_str str_split(const string &source, string sep = "\t",
   if (sep.size() == 1)
     return str_split(source, sep[0], empty);
 
-  vec_str result{};
-
-  if (sep.length() > 5)
-    split<string, bmhs>(begin(source), end(source), begin(sep), end(sep),
-                        back_inserter(result));
-  else
-    split<string, defs>(begin(source), end(source), begin(sep), end(sep),
-                        back_inserter(result));
-
-  if (!empty)
-    result.erase(remove(begin(result), end(result), ""), end(result));
-
-  return result;
+  return Splitter{std::move(sep)}.split(source, empty);
 }
 
 inline vec_str str_segment(const string &source, size_t length) {
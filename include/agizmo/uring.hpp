@@ -0,0 +1,254 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define AGIZMO_URING 1
+#endif
+#endif
+
+namespace AGizmo::Uring {
+
+using runerror = std::runtime_error;
+
+// Function reads size bytes at offset, retrying interrupted and short reads.
+// Returns number of bytes read, smaller than size only at the end of file,
+// or negated errno.
+inline long read_at(int fd, char *buffer, size_t size, uint64_t offset) {
+  size_t total{0};
+  while (total < size) {
+    const auto count = pread(fd, buffer + total, size - total,
+                             static_cast<off_t>(offset + total));
+    if (count < 0 && errno == EINTR)
+      continue;
+    if (count < 0)
+      return -errno;
+    if (count == 0)
+      break;
+    total += static_cast<size_t>(count);
+  }
+  return static_cast<long>(total);
+}
+
+// Read of size bytes at offset of fd into buffer. Once done is set, result
+// holds number of bytes read or negated errno. Request must stay in place
+// until it is done.
+struct Request {
+  int fd{-1};
+  char *buffer{nullptr};
+  size_t size{0};
+  uint64_t offset{0};
+  long result{0};
+  bool done{true};
+};
+
+// Submission and completion queues of io_uring, set up with raw system calls
+// so liburing is not needed. Requests of many files can share one ring and
+// stay in flight together. When kernel does not support io_uring (or
+// use_kernel is false) requests are read with pread on submission.
+// Ring is not thread-safe, function shared gives one ring per thread.
+class Ring {
+private:
+  unsigned entries{0};
+  unsigned in_flight{0};
+  unsigned queued{0};
+  int fd{-1};
+
+#ifdef AGIZMO_URING
+  void *sq_ring{MAP_FAILED};
+  void *cq_ring{MAP_FAILED};
+  size_t sq_size{0};
+  size_t cq_size{0};
+  io_uring_sqe *sqes{static_cast<io_uring_sqe *>(MAP_FAILED)};
+  size_t sqes_size{0};
+
+  unsigned *sq_tail{nullptr};
+  unsigned *sq_mask{nullptr};
+  unsigned *sq_array{nullptr};
+  unsigned *cq_head{nullptr};
+  unsigned *cq_tail{nullptr};
+  unsigned *cq_mask{nullptr};
+  io_uring_cqe *cqes{nullptr};
+
+  template <class Type> static Type *at(void *ring, unsigned offset) {
+    return reinterpret_cast<Type *>(static_cast<char *>(ring) + offset);
+  }
+
+  void setup(unsigned requested) {
+    io_uring_params params{};
+    fd = static_cast<int>(syscall(__NR_io_uring_setup, requested, &params));
+    if (fd < 0)
+      return;
+
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single)
+      sq_size = cq_size = std::max(sq_size, cq_size);
+
+    sq_ring = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    cq_ring = single ? sq_ring
+                     : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe *>(
+        mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+      release();
+      return;
+    }
+
+    sq_tail = at<unsigned>(sq_ring, params.sq_off.tail);
+    sq_mask = at<unsigned>(sq_ring, params.sq_off.ring_mask);
+    sq_array = at<unsigned>(sq_ring, params.sq_off.array);
+    cq_head = at<unsigned>(cq_ring, params.cq_off.head);
+    cq_tail = at<unsigned>(cq_ring, params.cq_off.tail);
+    cq_mask = at<unsigned>(cq_ring, params.cq_off.ring_mask);
+    cqes = at<io_uring_cqe>(cq_ring, params.cq_off.cqes);
+    entries = params.sq_entries;
+  }
+
+  void release() noexcept {
+    if (sqes != MAP_FAILED)
+      munmap(sqes, sqes_size);
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring)
+      munmap(cq_ring, cq_size);
+    if (sq_ring != MAP_FAILED)
+      munmap(sq_ring, sq_size);
+    sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    sq_ring = cq_ring = MAP_FAILED;
+    if (fd >= 0)
+      ::close(fd);
+    fd = -1;
+    entries = 0;
+  }
+
+  // Function submits queued entries and waits for min_complete completions.
+  void enter(unsigned min_complete) {
+    const auto count = syscall(__NR_io_uring_enter, fd, queued, min_complete,
+                               min_complete ? IORING_ENTER_GETEVENTS : 0,
+                               nullptr, 0);
+    if (count < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+        return;
+      throw runerror{"io_uring_enter failed: " +
+                     std::string(std::strerror(errno)) + "\n"};
+    }
+    queued -= std::min(queued, static_cast<unsigned>(count));
+  }
+
+  // Function marks requests of all available completions as done.
+  unsigned reap() noexcept {
+    auto head = *cq_head;
+    const auto tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    const auto count = tail - head;
+
+    for (; head != tail; ++head) {
+      const auto &cqe = cqes[head & *cq_mask];
+      auto request = reinterpret_cast<Request *>(cqe.user_data);
+      request->result = cqe.res;
+      request->done = true;
+    }
+
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    in_flight -= count;
+    return count;
+  }
+#endif
+
+public:
+  static constexpr unsigned default_entries{64};
+
+  explicit Ring(unsigned entries = default_entries, bool use_kernel = true) {
+#ifdef AGIZMO_URING
+    if (use_kernel)
+      setup(std::max(entries, 1u));
+#endif
+  }
+  Ring(const Ring &) = delete;
+  Ring &operator=(const Ring &) = delete;
+
+  // Requests in flight are finished, as their buffers may be still written.
+  ~Ring() {
+#ifdef AGIZMO_URING
+    try {
+      while (active() && in_flight)
+        if (!reap())
+          enter(1);
+    } catch (const runerror &) {
+    }
+    release();
+#endif
+  }
+
+  static std::shared_ptr<Ring> shared() {
+    thread_local const auto ring = std::make_shared<Ring>();
+    return ring;
+  }
+
+  // Function checks if requests are served by io_uring instead of pread.
+  bool active() const noexcept { return fd >= 0; }
+  unsigned size() const noexcept { return entries; }
+
+  void submit(Request &request) {
+    request.done = false;
+
+#ifdef AGIZMO_URING
+    if (active()) {
+      while (in_flight == entries)
+        if (!reap())
+          enter(1);
+
+      const auto tail = *sq_tail;
+      const auto index = tail & *sq_mask;
+      auto &sqe = sqes[index];
+      std::memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = IORING_OP_READ;
+      sqe.fd = request.fd;
+      sqe.addr = reinterpret_cast<uintptr_t>(request.buffer);
+      sqe.len = static_cast<uint32_t>(
+          std::min<size_t>(request.size, UINT32_MAX & ~size_t{4095}));
+      sqe.off = request.offset;
+      sqe.user_data = reinterpret_cast<uintptr_t>(&request);
+      sq_array[index] = index;
+      __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+      ++queued;
+      ++in_flight;
+      enter(0);
+      return;
+    }
+#endif
+
+    request.result =
+        read_at(request.fd, request.buffer, request.size, request.offset);
+    request.done = true;
+  }
+
+  // Function waits until request is done, completing others on the way.
+  void wait(Request &request) {
+#ifdef AGIZMO_URING
+    while (!request.done)
+      if (!reap())
+        enter(1);
+#endif
+  }
+};
+
+} // namespace AGizmo::Uring
@@ -5,12 +5,17 @@
 #include "agizmo/files.hpp"
 #include "agizmo/strings.hpp"
 
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
 
 using sstream = std::stringstream;
 
+// Number of calls of global operator new, replaced in basic_test.cpp.
+extern std::atomic<size_t> allocations;
+
 using namespace AGizmo;
 using namespace Evaluation;
 // using namespace StringFormat;
@@ -280,6 +285,103 @@ public:
   string args() const { return "(" + this->input + ")"; }
 };
 
+struct StrSearchInput {
+  string source;
+  string queries;
+};
+
+// Outcome holds count_all of first query, count_any, find_first_of (-1 when
+// not found) and flags of source starting and ending with queries.
+class StrSearch : public BaseTest<StrSearchInput, PrintableVector<long>> {
+public:
+  StrSearch(StrSearchInput input, PrintableVector<long> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    using namespace StringSearch;
+    const auto found = find_first_of(input.source, input.queries);
+    outcome = PrintableVector<long>{
+        input.queries.empty() ? 0 : count_all(input.source, input.queries[0]),
+        count_any(input.source, input.queries),
+        found == string::npos ? -1 : static_cast<long>(found),
+        str_starts_with(input.source, input.queries),
+        str_ends_with(input.source, input.queries)};
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    auto content = input.source.size() > 40 ? input.source.substr(0, 37) + "..."
+                                            : input.source;
+    return "(" + content + ", " + input.queries + ")";
+  }
+};
+
+class StrToDouble : public BaseTest<string, PrintableOptional<double>> {
+public:
+  StrToDouble(string input, PrintableOptional<double> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    outcome = PrintableOptional(StringFormat::str_to_number<double>(input));
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const { return "(" + this->input + ")"; }
+};
+
+// Input holds comma separated fields, outcome holds numbers preceding the
+// first invalid field.
+class StrToNumbers : public BaseTest<string, PrintableVector<int64_t>> {
+public:
+  StrToNumbers(string input, PrintableVector<int64_t> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    const auto fields = StringDecompose::str_split_view(input, ',', true);
+    vector<int64_t> numbers;
+    numbers.resize(StringFormat::str_to_numbers(fields, numbers));
+    outcome = PrintableVector(numbers);
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const { return "(" + this->input + ")"; }
+};
+
+struct StrDoubleInput {
+  double number;
+  int step{3}, precision{0};
+};
+
+class StrDouble : public BaseTest<StrDoubleInput, string> {
+public:
+  StrDouble(StrDoubleInput input, string expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome + "\nExpected: " + expected;
+  }
+
+  bool validate() {
+    outcome =
+        StringFormat::str_double(input.number, input.step, input.precision);
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + std::to_string(input.number) + ", " +
+           std::to_string(input.step) + ", " + std::to_string(input.precision) +
+           ")";
+  }
+};
+
 class StrCleanEnds : public BaseTest<string, string> {
 public:
   StrCleanEnds(string input, string expected);
@@ -328,7 +430,9 @@ public:
 
   bool validate() {
     outcome = StringFormat::str_clean(input);
-    return this->setStatus(outcome == expected);
+    string cleaned{input};
+    StringFormat::str_clean_in_place(cleaned);
+    return this->setStatus(outcome == expected && cleaned == expected);
   }
 
   string args() const { return "(" + this->input + ")"; }
@@ -344,7 +448,9 @@ public:
 
   bool validate() {
     outcome = StringFormat::str_clean(input.query, true, input.chars);
-    return this->setStatus(outcome == expected);
+    string cleaned{input.query};
+    StringFormat::str_clean_in_place(cleaned, true, input.chars);
+    return this->setStatus(outcome == expected && cleaned == expected);
   }
 
   string args() const {
@@ -368,6 +474,89 @@ public:
   string args() const { return "(" + this->input.str() + ")"; }
 };
 
+class StrJoinQuoted : public BaseTest<PrintableVector<string>, string> {
+public:
+  StrJoinQuoted(PrintableVector<string> input, string expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome + "\nExpected: " + expected;
+  }
+
+  bool validate() {
+    outcome = StringCompose::str_join_quoted(input.value, ',');
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const { return "(" + this->input.str() + ")"; }
+};
+
+// Input holds fields separated with ';' and keys separated from values
+// with '=', which are joined back with '|' and ':'.
+class StrJoinFields : public BaseTest<string, string> {
+public:
+  StrJoinFields(string input, string expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome + "\nExpected: " + expected;
+  }
+
+  bool validate() {
+    vector<pair<string, opt_str>> fields;
+    for (const auto &field : StringDecompose::str_split(input, ';', false)) {
+      const auto mark = field.find('=');
+      fields.emplace_back(field.substr(0, mark),
+                          mark == string::npos
+                              ? opt_str{}
+                              : opt_str{field.substr(mark + 1)});
+    }
+    outcome = StringCompose::str_join_fields(fields, "|", ":");
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const { return "(" + this->input + ")"; }
+};
+
+struct StringBuilderInput {
+  string text;
+  int64_t number;
+  size_t width;
+  double value;
+};
+
+class StringBuilderTest : public BaseTest<StringBuilderInput, string> {
+public:
+  StringBuilderTest(StringBuilderInput input, string expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome + "\nExpected: " + expected;
+  }
+
+  bool validate() {
+    StringCompose::StringBuilder output;
+    output.append(input.text).append(input.number, input.width);
+    output << ' ' << input.value << ' ';
+    output.append(input.value, 0, 2);
+    outcome = output.str();
+
+    // Character types are written as characters, like std::ostream does.
+    const auto symbol = input.text.empty() ? '?' : input.text[0];
+    StringCompose::StringBuilder chars;
+    sstream stream;
+    chars << static_cast<int8_t>(symbol) << static_cast<uint8_t>(symbol);
+    stream << static_cast<int8_t>(symbol) << static_cast<uint8_t>(symbol);
+
+    return this->setStatus(outcome == expected &&
+                           output.size() == expected.size() &&
+                           chars.view() == stream.str());
+  }
+
+  string args() const {
+    return "(" + input.text + ", " + std::to_string(input.number) + ", " +
+           std::to_string(input.width) + ", " + std::to_string(input.value) +
+           ")";
+  }
+};
+
 class StrReverse : public BaseTest<string, string> {
 public:
   StrReverse(string input, string expected);
@@ -403,6 +592,253 @@ public:
   }
 };
 
+using StrSplitOffsetsInput = pair<string, char>;
+
+class StrSplitOffsets
+    : public BaseTest<StrSplitOffsetsInput, PrintableVector<size_t>> {
+public:
+  StrSplitOffsets(StrSplitOffsetsInput input, PrintableVector<size_t> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    outcome = PrintableVector(
+        StringDecompose::str_split_offsets(input.first, input.second));
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    auto content = input.first.size() > 40 ? input.first.substr(0, 37) + "..."
+                                           : input.first;
+    return "(" + content + "," + input.second + ")";
+  }
+};
+
+struct StrSplitQuotedInput {
+  string source;
+  char escape{0};
+};
+
+// Split on ',' outside '"', checked against offsets and every overload of
+// views, which must not allocate. Unclosed quotation is expected as
+// {"error"}.
+class StrSplitQuoted
+    : public BaseTest<StrSplitQuotedInput, PrintableVector<string>> {
+public:
+  StrSplitQuoted(StrSplitQuotedInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    using namespace StringDecompose;
+    try {
+      const auto fields =
+          str_split_quoted(input.source, ',', '"', input.escape);
+      const auto views = str_split_view(input.source, ',', '"', input.escape);
+      const auto offsets =
+          str_split_quoted_offsets(input.source, ',', '"', input.escape);
+
+      // Reused output and array have to match too, without allocations.
+      vector<std::string_view> reused{"stale"};
+      reused.reserve(64);
+      std::array<std::string_view, 64> array{};
+      const auto before = allocations.load();
+      str_split_view(input.source, ',', '"', reused, true, input.escape);
+      const auto count =
+          str_split_view(input.source, ',', '"', array, true, input.escape);
+      const auto allocated = allocations.load() - before;
+
+      outcome = PrintableVector(fields);
+      return this->setStatus(
+          outcome == expected &&
+          std::equal(fields.begin(), fields.end(), views.begin(),
+                     views.end()) &&
+          std::equal(views.begin(), views.end(), reused.begin(),
+                     reused.end()) &&
+          std::equal(views.begin(), views.end(), array.begin(),
+                     array.begin() + count) &&
+          !allocated &&
+          offsets.size() + !input.source.empty() == fields.size());
+    } catch (const std::runtime_error &) {
+      outcome = PrintableVector<string>{"error"};
+      return this->setStatus(outcome == expected);
+    }
+  }
+
+  string args() const {
+    auto content = input.source.size() > 40
+                       ? input.source.substr(0, 37) + "..."
+                       : input.source;
+    return "(" + content + (input.escape ? string(",") + input.escape : "") +
+           ")";
+  }
+};
+
+struct StrSplitViewInput {
+  string source;
+  string sep;
+  char quote{0};
+  bool empty{true};
+  bool array{false};
+};
+
+// Separator of single character selects char overload, non-zero quote the
+// quoted one. Array variant stores at most 3 fields.
+class StrSplitView
+    : public BaseTest<StrSplitViewInput, PrintableVector<string>> {
+public:
+  StrSplitView(StrSplitViewInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  template <class Output> size_t split(Output &output) const {
+    using StringDecompose::str_split_view;
+    if (input.quote)
+      return str_split_view(input.source, input.sep[0], input.quote, output,
+                            input.empty);
+    if (input.sep.size() == 1)
+      return str_split_view(input.source, input.sep[0], output, input.empty);
+    return str_split_view(input.source, std::string_view(input.sep), output,
+                          input.empty);
+  }
+
+  bool validate() {
+    try {
+      if (input.array) {
+        std::array<std::string_view, 3> fields{};
+        const auto count = split(fields);
+        outcome.value.assign(fields.begin(), fields.begin() + count);
+      } else {
+        vector<std::string_view> fields{"stale"};
+        split(fields);
+        outcome.value.assign(fields.begin(), fields.end());
+      }
+    } catch (const std::runtime_error &) {
+      outcome.value = {"error"};
+    }
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + input.source + "," + input.sep +
+           (input.quote ? string(",") + input.quote : "") + "," +
+           to_string(input.empty) + "," + to_string(input.array) + ")";
+  }
+};
+
+struct StrReplaceNInput {
+  string source;
+  vector<pair<string, string>> index;
+};
+
+class StrReplaceN : public BaseTest<StrReplaceNInput, string> {
+public:
+  StrReplaceN(StrReplaceNInput input, string expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome + "\nExpected: " + expected;
+  }
+
+  bool validate() {
+    outcome = StringFormat::str_replace_n(input.source, input.index);
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    const auto shorten = [](const string &text) {
+      return text.size() > 40 ? text.substr(0, 37) + "..." : text;
+    };
+    string index{};
+    for (const auto &[pattern, value] : input.index)
+      index += shorten(pattern) + "->" + value + ";";
+    return "(" + shorten(input.source) + ", " + index + ")";
+  }
+};
+
+struct SplitRangeInput {
+  string source;
+  string sep;
+  size_t skip{0};
+  size_t take{string::npos};
+};
+
+// Fields are taken lazily after skipping first skip of them with std::next.
+class SplitRangeTest
+    : public BaseTest<SplitRangeInput, PrintableVector<string>> {
+public:
+  SplitRangeTest(SplitRangeInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  template <class Range> void take(const Range &range) {
+    size_t count{0};
+    for (auto field = std::next(range.begin(), input.skip);
+         field != range.end(); ++field) {
+      if (count++ == input.take)
+        break;
+      outcome.value.emplace_back(*field);
+    }
+  }
+
+  bool validate() {
+    using StringDecompose::split_range;
+    if (input.sep.size() == 1)
+      take(split_range(input.source, input.sep[0]));
+    else
+      take(split_range(input.source, std::string_view(input.sep)));
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + input.source + "," + input.sep + "," +
+           to_string(input.skip) + "," +
+           (input.take == string::npos ? "all" : to_string(input.take)) + ")";
+  }
+};
+
+// Owning, view and lazy splitting of Splitter have to agree.
+class SplitterTest : public BaseTest<pair_str, PrintableVector<string>> {
+public:
+  SplitterTest(pair_str input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    const StringDecompose::Splitter splitter{input.second};
+    outcome = PrintableVector(splitter.split(input.first));
+
+    vector<std::string_view> views{};
+    splitter.split(input.first, views);
+    vector<string> lazy{};
+    for (const auto field : splitter.range(input.first))
+      lazy.emplace_back(field);
+
+    if (!std::equal(views.begin(), views.end(), outcome.value.begin(),
+                    outcome.value.end()) ||
+        lazy != outcome.value)
+      outcome.value = {"mismatch"};
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    const auto shorten = [](const string &text) {
+      return text.size() > 20 ? text.substr(0, 17) + "..." : text;
+    };
+    return "(" + shorten(input.first) + "," + shorten(input.second) + ")";
+  }
+};
+
 struct StrReplaceInput {
   string source, query, value;
 };
@@ -417,6 +853,14 @@ public:
 
   bool validate() {
     outcome = StringFormat::str_replace(input.source, input.query, input.value);
+
+    // Appending variant has to agree and keep content of output.
+    string appended{"prefix:"};
+    StringFormat::str_replace_into(input.source, input.query, input.value,
+                                   appended);
+    if (appended != "prefix:" + outcome)
+      outcome = "mismatch: " + appended;
+
     return this->setStatus(outcome == expected);
   }
 
@@ -452,3 +896,657 @@ public:
 
   string args() const { return "(" + this->input + ")"; }
 };
+
+struct ReadFileInput {
+  string content;
+  Files::ReadMode mode;
+  string skip{};
+  size_t block_size{Files::default_block_size};
+};
+
+class ReadFile : public BaseTest<ReadFileInput, PrintableVector<string>> {
+public:
+  ReadFile(ReadFileInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    auto file = std::ofstream("test_read.txt");
+    file << input.content;
+    file.close();
+
+    try {
+      Files::FileReader reader{"test_read.txt", input.mode, input.block_size};
+      while (reader.readLine(input.skip))
+        outcome.value.push_back(to_string(reader.getLineNum()) + ":" +
+                                reader.getLine());
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    auto content = input.content.size() > 40
+                       ? input.content.substr(0, 37) + "..."
+                       : input.content;
+    return "(" + StringFormat::str_replace(content, "\n", "\\n") + ", " +
+           std::to_string(static_cast<int>(input.mode)) + ", " +
+           input.skip + ", " + std::to_string(input.block_size) + ")";
+  }
+};
+
+struct ReadShardsInput {
+  vector<string> contents;
+  size_t workers;
+  uint64_t range_size;
+};
+
+// Files test_shard_<i>.txt are found with glob. Outcome holds every line
+// prefixed with index of its file, sorted, and totals of ReadSummary.
+class ReadShards : public BaseTest<ReadShardsInput, PrintableVector<string>> {
+public:
+  ReadShards(ReadShardsInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    for (size_t i = 0; i < 10; ++i)
+      std::remove(("test_shard_" + to_string(i) + ".txt").c_str());
+    for (size_t i = 0; i < input.contents.size(); ++i) {
+      auto file = std::ofstream("test_shard_" + to_string(i) + ".txt");
+      file << input.contents[i];
+    }
+
+    try {
+      Files::MultiFileReader reader{Files::glob_files("test_shard_*.txt"),
+                                    input.workers, input.range_size};
+      vector<vector<string>> seen(reader.getWorkers());
+      const auto summary = reader.forEachLine(
+          [&seen](size_t worker, size_t file, std::string_view line) {
+            seen[worker].push_back(to_string(file) + ":" + string(line));
+          });
+
+      for (const auto &lines : seen)
+        outcome.value.insert(outcome.value.end(), lines.begin(), lines.end());
+      std::sort(outcome.value.begin(), outcome.value.end());
+      outcome.value.push_back(to_string(summary.files) + " files " +
+                              to_string(summary.lines) + " lines " +
+                              to_string(summary.bytes) + " bytes");
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + to_string(input.contents.size()) + " files, " +
+           to_string(input.workers) + ", " + to_string(input.range_size) +
+           ")";
+  }
+};
+
+struct ReadUringInput {
+  string content;
+  bool use_kernel;
+  size_t readers;
+};
+
+// Readers share small ring and are read in turns, so requests of different
+// files complete out of order. Outcome holds number of lines and characters
+// read by every reader.
+class ReadUring : public BaseTest<ReadUringInput, PrintableVector<string>> {
+public:
+  ReadUring(ReadUringInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    auto file = std::ofstream("test_read_uring.txt");
+    file << input.content;
+    file.close();
+
+    try {
+      const auto ring = std::make_shared<Uring::Ring>(2, input.use_kernel);
+      vector<std::unique_ptr<Files::FileReader>> readers;
+      for (size_t i = 0; i < input.readers; ++i)
+        readers.push_back(std::make_unique<Files::FileReader>(
+            std::make_unique<Files::UringSource>("test_read_uring.txt", 1, 3,
+                                                 ring)));
+
+      vector<std::pair<size_t, size_t>> counts(input.readers);
+      for (bool reading = true; reading;) {
+        reading = false;
+        for (size_t i = 0; i < input.readers; ++i)
+          if (readers[i]->nextLine()) {
+            ++counts[i].first;
+            counts[i].second += readers[i]->getLineView().size();
+            reading = true;
+          }
+      }
+
+      for (const auto &[lines, characters] : counts)
+        outcome.value.push_back(to_string(lines) + ":" +
+                                to_string(characters));
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + to_string(input.content.size()) + ", " +
+           (input.use_kernel ? "true" : "false") + ", " +
+           to_string(input.readers) + ")";
+  }
+};
+
+// Outcome holds number of characters of every line and code points of its
+// non-ASCII characters, or line number where invalid UTF-8 was reported.
+class ReadFileWide : public BaseTest<string, PrintableVector<string>> {
+public:
+  ReadFileWide(string input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    auto file = std::ofstream("test_read_wide.txt");
+    file << input;
+    file.close();
+
+    Files::FileReaderWide reader{"test_read_wide.txt"};
+    try {
+      while (reader.readLine()) {
+        const auto line = reader.getLineU32();
+        if (line.size() != reader.getLine().size())
+          throw std::runtime_error{"Wide and UTF-32 lines differ\n"};
+        auto described = to_string(line.size());
+        for (const auto code : line)
+          if (code >= 0x80) {
+            char hex[8];
+            const auto end =
+                std::to_chars(hex, hex + 8, uint32_t{code}, 16).ptr;
+            described += " U+" + string(hex, end);
+          }
+        outcome.value.push_back(described);
+      }
+    } catch (const std::runtime_error &) {
+      outcome.value.push_back("invalid:" + to_string(reader.getLineNum()));
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    auto content =
+        input.size() > 40 ? input.substr(0, 37) + "..." : string(input);
+    return "(" + StringFormat::str_replace(content, "\n", "\\n") + ")";
+  }
+};
+
+struct ParallelReadInput {
+  string content;
+  size_t workers;
+};
+
+class ParallelRead
+    : public BaseTest<ParallelReadInput, PrintableVector<string>> {
+public:
+  ParallelRead(ParallelReadInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    auto file = std::ofstream("test_parallel.txt");
+    file << input.content;
+    file.close();
+
+    try {
+      Files::ParallelReader reader{"test_parallel.txt", input.workers, true};
+      outcome.value = reader.reduce(
+          vector<string>{},
+          [](const Files::LineRange &range) {
+            vector<string> lines{};
+            for (auto it = range.begin(); it != range.end(); ++it)
+              lines.push_back(to_string(it.getLineNum()) + ":" + string(*it));
+            return lines;
+          },
+          [](vector<string> result, vector<string> lines) {
+            result.insert(result.end(), lines.begin(), lines.end());
+            return result;
+          });
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + StringFormat::str_replace(input.content, "\n", "\\n") +
+           ", " + to_string(input.workers) + ")";
+  }
+};
+
+#ifdef AGIZMO_ZLIB
+
+// Function writes content as BGZF file made of blocks holding at most
+// block_size bytes of input, followed by empty end-of-file block.
+inline void write_bgzf(const string &file_name, const string &content,
+                       size_t block_size) {
+  std::ofstream output(file_name, std::ios::binary);
+
+  const auto put = [&output](uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i, value >>= 8)
+      output.put(static_cast<char>(value & 0xff));
+  };
+
+  for (size_t pos = 0;; pos += block_size) {
+    const auto part = content.substr(std::min(pos, content.size()), block_size);
+
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                 Z_DEFAULT_STRATEGY);
+    string compressed(deflateBound(&stream, part.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(part.data()));
+    stream.avail_in = static_cast<uInt>(part.size());
+    stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    output.write("\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0", 16);
+    put(static_cast<uint32_t>(compressed.size() + 25), 2);
+    output << compressed;
+    put(crc32(0, reinterpret_cast<const Bytef *>(part.data()),
+              static_cast<uInt>(part.size())),
+        4);
+    put(static_cast<uint32_t>(part.size()), 4);
+
+    if (part.empty())
+      break;
+  }
+}
+
+inline void write_gzip(const string &file_name, const string &content) {
+  auto output = gzopen(file_name.c_str(), "wb");
+  gzwrite(output, content.data(), static_cast<unsigned>(content.size()));
+  gzclose(output);
+}
+
+struct ReadCompressedInput {
+  string content;
+  size_t block_size;
+};
+
+class ReadCompressed
+    : public BaseTest<ReadCompressedInput, PrintableVector<string>> {
+public:
+  ReadCompressed(ReadCompressedInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    if (input.block_size)
+      write_bgzf("test_read.gz", input.content, input.block_size);
+    else
+      write_gzip("test_read.gz", input.content);
+
+    try {
+      Files::FileReader reader{"test_read.gz"};
+      while (reader.readLine())
+        outcome.value.push_back(to_string(reader.getLineNum()) + ":" +
+                                reader.getLine());
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + StringFormat::str_replace(input.content, "\n", "\\n") +
+           ", " + to_string(input.block_size) + ")";
+  }
+};
+
+// Input selects where BgzfSource is opened: 0 on calling thread, 1 by worker
+// of another pool, 2 with pool of 3 workers shared by caller. Outcome holds
+// number of workers of source and lines read.
+class BgzfWorkers : public BaseTest<int, string> {
+private:
+  static string read(std::unique_ptr<Files::BgzfSource> source) {
+    string result{to_string(source->getWorkers())};
+    Files::FileReader reader{std::move(source)};
+    while (reader.nextLine())
+      result += ":" + reader.getLine();
+    return result;
+  }
+
+public:
+  BgzfWorkers(int input, string expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome + "\nExpected: " + expected;
+  }
+
+  bool validate() {
+    write_bgzf("test_read.gz", "A\nB\nC\n", 2);
+
+    try {
+      if (input == 1) {
+        Parallel::ThreadPool pool{2};
+        outcome = pool.submit([]() {
+                        return read(std::make_unique<Files::BgzfSource>(
+                            "test_read.gz"));
+                      })
+                      .get();
+      } else if (input == 2) {
+        Parallel::ThreadPool pool{3};
+        outcome =
+            read(std::make_unique<Files::BgzfSource>("test_read.gz", pool));
+      } else
+        outcome = read(std::make_unique<Files::BgzfSource>("test_read.gz"));
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const { return "(" + to_string(input) + ")"; }
+};
+
+#endif
+
+struct SeekLineInput {
+  Files::ReadMode mode;
+  long step;
+  long line_num;
+};
+
+class SeekLine : public BaseTest<SeekLineInput, string> {
+public:
+  SeekLine(SeekLineInput input, string expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome + "\nExpected: " + expected;
+  }
+
+  bool validate() {
+    auto file = std::ofstream("test_seek.txt");
+    for (int i = 1; i <= 20; ++i)
+      file << "L" << i << "\n";
+    file.close();
+
+    try {
+      Files::FileReader reader{"test_seek.txt", input.mode};
+      reader.setIndex(std::make_shared<Files::LineIndex>(
+          Files::LineIndex::build("test_seek.txt", input.step)));
+      reader.seekLine(input.line_num);
+      outcome = to_string(reader.getLineNum()) + ":" + reader.getLine();
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + to_string(static_cast<int>(input.mode)) + ", " +
+           to_string(input.step) + ", " + to_string(input.line_num) + ")";
+  }
+};
+
+// Input names how sidecar or file is changed after index was saved.
+class LoadLineIndex : public BaseTest<string, string> {
+private:
+  static void patch(string &data, size_t pos, uint64_t value) {
+    std::memcpy(data.data() + pos, &value, sizeof(value));
+  }
+
+public:
+  LoadLineIndex(string input, string expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome + "\nExpected: " + expected;
+  }
+
+  bool validate() {
+    const string file_name{"test_index.txt"};
+    const auto sidecar = Files::LineIndex::sidecar(file_name);
+
+    auto file = std::ofstream(file_name);
+    for (int i = 1; i <= 20; ++i)
+      file << "L" << i << "\n";
+    file.close();
+
+    try {
+      const auto index = Files::LineIndex::build(file_name, 3);
+      index.save();
+
+      // Header holds magic, step, size, time, lines and count of offsets.
+      std::ifstream input(sidecar, std::ios::binary);
+      string data{std::istreambuf_iterator<char>(input), {}};
+      input.close();
+
+      if (this->input == "rewrite") {
+        // Longer lines move every line away from indexed offsets.
+        auto rewritten = std::ofstream(file_name);
+        for (int i = 1; i <= 20; ++i)
+          rewritten << "LL" << i << "\n";
+      }
+      else if (this->input == "step")
+        patch(data, 8, 0);
+      else if (this->input == "count")
+        patch(data, 40, uint64_t{1} << 60);
+      else if (this->input == "order")
+        patch(data, 56, 0);
+      else if (this->input == "range")
+        patch(data, data.size() - 8, index.getOffsets().back() + 1000);
+      else if (this->input == "truncate")
+        data.resize(data.size() - 4);
+      std::ofstream(sidecar, std::ios::binary) << data;
+
+      Files::LineIndex loaded{};
+      if (!loaded.load(file_name))
+        outcome = "rejected";
+      else if (loaded.getOffsets() != index.getOffsets())
+        outcome = "mismatch";
+      else
+        outcome = "loaded:" + to_string(loaded.getLines()) + ":" +
+                  to_string(loaded.size());
+
+      // Stale index in use is rebuilt, damaged sidecar is replaced.
+      Files::FileReader reader{file_name};
+      if (this->input == "rewrite")
+        reader.setIndex(std::make_shared<Files::LineIndex>(index));
+      reader.seekLine(20);
+      outcome += "|" + to_string(reader.getLineNum()) + ":" + reader.getLine();
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const { return "(" + input + ")"; }
+};
+
+struct ReadRecordsInput {
+  string content;
+  char sep;
+  string skip{};
+};
+
+class ReadRecords : public BaseTest<ReadRecordsInput, PrintableVector<string>> {
+public:
+  ReadRecords(ReadRecordsInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    auto file = std::ofstream("test_records.txt");
+    file << input.content;
+    file.close();
+
+    try {
+      Files::RecordReader reader{"test_records.txt", input.sep};
+      while (reader.readRecord(input.skip)) {
+        const auto &record = reader.getRecord();
+        outcome.value.push_back(
+            to_string(reader.getLineNum()) + ":" +
+            StringCompose::str_join(record.begin(), record.end(), "|") + ":" +
+            to_string(record.get<int>(0, -1)));
+      }
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + StringFormat::str_replace(input.content, "\n", "\\n") +
+           ", " + input.sep + ", " + input.skip + ")";
+  }
+};
+
+struct ProjectRecordsInput {
+  string content;
+  vector<size_t> columns{};
+  vector<string> names{};
+};
+
+class ProjectRecords
+    : public BaseTest<ProjectRecordsInput, PrintableVector<string>> {
+public:
+  ProjectRecords(ProjectRecordsInput input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    auto file = std::ofstream("test_records.txt");
+    file << input.content;
+    file.close();
+
+    try {
+      Files::RecordReader reader{"test_records.txt", ','};
+      if (input.names.empty())
+        reader.project(input.columns);
+      else
+        reader.project(input.names);
+      while (reader.readRecord()) {
+        const auto &record = reader.getRecord();
+        outcome.value.push_back(
+            StringCompose::str_join(record.begin(), record.end(), "|"));
+      }
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    return "(" + StringFormat::str_replace(input.content, "\n", "\\n") +
+           ", {" + StringCompose::str_join(input.columns, ",") + "}, {" +
+           StringCompose::str_join(input.names, ",") + "})";
+  }
+};
+
+// Records are given as line number after reading them and fields joined
+// with '|'. Error ends records with "error".
+class ReadCsv : public BaseTest<string, PrintableVector<string>> {
+public:
+  ReadCsv(string input, PrintableVector<string> expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome.str() + "\nExpected: " + expected.str();
+  }
+
+  bool validate() {
+    auto file = std::ofstream("test_records.txt");
+    file << input;
+    file.close();
+
+    try {
+      Files::CsvReader reader{"test_records.txt"};
+      while (reader.readRecord()) {
+        const auto &record = reader.getRecord();
+        outcome.value.push_back(
+            to_string(reader.getLineNum()) + ":" +
+            StringCompose::str_join(record.begin(), record.end(), "|"));
+      }
+    } catch (const std::runtime_error &) {
+      outcome.value.push_back("error");
+    }
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const {
+    auto content = StringFormat::str_replace(input, "\n", "\\n");
+    if (content.size() > 40)
+      content = content.substr(0, 37) + "...";
+    return "(" + content + ")";
+  }
+};
+
+class WriteFile : public BaseTest<size_t, string> {
+public:
+  WriteFile(size_t input, string expected);
+
+  string str() const noexcept {
+    return "Outcome: " + outcome + "\nExpected: " + expected;
+  }
+
+  bool validate() {
+    try {
+      Files::FileWriter writer{"test_write.txt", input};
+      writer.writeRecord('\t', "A", 1, -2, 0.5, string(5000, 'B'));
+      writer.writeField("x", ',').writeField(42u, ',').endLine();
+      writer << 18446744073709551615ull << ' ' << 0.1 << ' ';
+      writer.write(2.0 / 3, std::chars_format::fixed, 3).endLine();
+      const vector<long> values{-1, 0, 1};
+      writer.writeRecord(values.begin(), values.end(), ';');
+      writer.writeField(1, ',').writeField(2, ',');
+      writer.write("\n");
+      writer.writeField(3, ',').write("").writeField(4, ',').endLine();
+      for (int i = 0; i < 100; ++i)
+        writer.writeRecord(',', i, i * i);
+      writer.write(1e100, std::chars_format::fixed, 2).endLine();
+      writer.write(-1e300, std::chars_format::fixed, 0).endLine();
+      writer.writeRecord(';', 'x', 'y');
+    } catch (const std::runtime_error &ex) {
+      std::cerr << ex.what();
+    }
+
+    std::ifstream file("test_write.txt");
+    outcome = string(std::istreambuf_iterator<char>(file), {});
+
+    return this->setStatus(outcome == expected);
+  }
+
+  string args() const { return "(" + to_string(input) + ")"; }
+};
@@ -1,8 +1,10 @@
 #include "basic_test.hpp"
 
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <new>
 
 #include <numeric>
 
@@ -20,6 +22,39 @@ using std::move;
 using std::next;
 using std::to_string;
 
+// Replaced global allocation functions count allocations, so tests can
+// require code paths to be allocation free.
+std::atomic<size_t> allocations{0};
+
+void *operator new(size_t size) {
+  ++allocations;
+  if (auto result = std::malloc(size ? size : 1))
+    return result;
+  throw std::bad_alloc{};
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  ++allocations;
+  return std::malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+
 Stats check_XOR(bool verbose = false) {
   Stats result;
   sstream message;
@@ -216,6 +251,40 @@ Stats check_only_digits(bool verbose) {
   return result;
 }
 
+Stats check_str_search(bool verbose) {
+  Stats result;
+  sstream message, failure;
+
+  message << "\n~~~ Checking StringSearch\n\nTesting strings:\n";
+
+  string line(100, '.');
+  line[3] = line[70] = '\t';
+  line[99] = ' ';
+
+  vector<StrSearch> tests = {
+      {{"", ""}, {0, 0, -1, 1, 1}},
+      {{"abc", ""}, {0, 0, -1, 1, 1}},
+      {{"abcabc", "c"}, {2, 2, 2, 0, 1}},
+      {{"abcabc", "ab"}, {2, 4, 0, 1, 0}},
+      {{"abc", "abcd"}, {1, 3, 0, 0, 0}},
+      {{line, "\t "}, {2, 3, 3, 0, 0}},
+      {{line, " \xff"}, {1, 1, 99, 0, 0}},
+  };
+
+  Evaluator eval("StringSearch", tests);
+  result(eval.verify());
+
+  if (verbose)
+    cout << message.str() << eval.message << "\n";
+  else if (eval.hasFailed())
+    cout << message.str() << eval.failed << "\n";
+
+  cout << "~~~ " << gen_summary(result, "Checking StringSearch functions")
+       << endl;
+
+  return result;
+}
+
 Stats check_str_to_int(bool verbose) {
   Stats result;
   sstream message, failure;
@@ -229,6 +298,12 @@ Stats check_str_to_int(bool verbose) {
       {"", {PrintableOptional<int>()}},
       {"A123", {PrintableOptional<int>()}},
       {"123-456", {PrintableOptional<int>()}},
+      {"-5", {PrintableOptional<int>()}},
+      {"2147483647", {2147483647}},
+      {"2147483648", {PrintableOptional<int>()}},
+      {"99999999999999999999999", {PrintableOptional<int>()}},
+      {"00000000000000000123", {123}},
+      {"1234567890", {1234567890}},
   };
 
   Evaluator eval("StringFormat::str_to_int", tests);
@@ -246,6 +321,98 @@ Stats check_str_to_int(bool verbose) {
   return result;
 }
 
+Stats check_str_to_number(bool verbose) {
+  Stats result;
+  sstream message, failure;
+
+  message << "\n~~~ Checking StringFormat::str_to_number\n"
+          << "\nTesting doubles:\n";
+
+  vector<StrToDouble> tests = {
+      {"0", {0.0}},
+      {"-12.5", {-12.5}},
+      {"3.14159265358979", {3.14159265358979}},
+      {"1e3", {1000.0}},
+      {"0.000001", {0.000001}},
+      {"12.", {12.0}},
+      {"", {std::nullopt}},
+      {"1.5x", {std::nullopt}},
+      {"--1", {std::nullopt}},
+  };
+
+  Evaluator eval("StringFormat::str_to_number", tests);
+  result(eval.verify());
+
+  if (verbose)
+    cout << message.str() << eval.message << "\n";
+  else if (eval.hasFailed())
+    cout << message.str() << eval.failed << "\n";
+
+  message.str("");
+  message << "\nTesting columns of integers:\n";
+
+  vector<StrToNumbers> tests_numbers = {
+      {"1,-2,3", {1, -2, 3}},
+      {"12345678,123456789012,-9223372036854775808",
+       {12345678, 123456789012, std::numeric_limits<int64_t>::min()}},
+      {"1,2,x,4", {1, 2}},
+      {"1,9223372036854775808", {1}},
+      {"7,,8", {7}},
+  };
+
+  Evaluator eval_numbers("StringFormat::str_to_numbers", tests_numbers);
+  result(eval_numbers.verify());
+
+  if (verbose)
+    cout << message.str() << eval_numbers.message << "\n";
+  else if (eval_numbers.hasFailed())
+    cout << message.str() << eval_numbers.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result, "Checking StringFormat::str_to_number function")
+       << endl;
+
+  return result;
+}
+
+Stats check_str_double(bool verbose) {
+  Stats result;
+  sstream message, failure;
+
+  message << "\n~~~ Checking StringFormat::str_double\n"
+          << "\nTesting numbers:\n";
+
+  vector<StrDouble> tests = {
+      {{0.0}, "0"},
+      {{-0.0}, "-0"},
+      {{1.5}, "1.5"},
+      {{-1234.5678}, "-1.235e+03"},
+      {{-12.345}, "-12.3"},
+      {{123456.0, 3, 2}, "1.23e+05"},
+      {{0.0001234}, "1.234e-04"},
+      {{std::nan("")}, "nan"},
+      {{std::numeric_limits<double>::infinity()}, "inf"},
+      {{0.1 + 0.2, 0}, "0.30000000000000004"},
+      {{2.5, 0, 3}, "2.500"},
+      {{-0x1p100, 0, 120},
+       "-1267650600228229401496703205376." + string(120, '0')},
+  };
+
+  Evaluator eval("StringFormat::str_double", tests);
+  result(eval.verify());
+
+  if (verbose)
+    cout << message.str() << eval.message << "\n";
+  else if (eval.hasFailed())
+    cout << message.str() << eval.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result, "Checking StringFormat::str_double function")
+       << endl;
+
+  return result;
+}
+
 Stats check_str_clean_ends(bool verbose) {
   Stats result;
   sstream message;
@@ -281,6 +448,7 @@ Stats check_str_clean_ends(bool verbose) {
       {{"    ", " \n"}, ""},
       {{"\n\n\n\n", "\n "}, ""},
       {{"\n\n \n", "\n "}, ""},
+      {{"\t\v A \r\n\f B\r\n", "\t\r"}, "\v A \r\n\f B\r\n"},
   };
 
   Evaluator test_clean_with_chars("StringFormat::str_clean_ends",
@@ -310,6 +478,11 @@ Stats check_str_clean(bool verbose) {
       {"  \nA  B  \n", "A B"},  {"    ", ""},           {"", ""},
       {"A  B", "A B"},          {" \t A  B", "\t A B"}, {"A  B \t ", "A B \t"},
       {"A\t   \tB", "A\t \tB"},
+      {"  first\n\n\nsecond    third\nfourth   fifth sixth seventh\n\n",
+       "first second third fourth fifth sixth seventh"},
+      {"\xc5\xbc\xc3\xb3\xc5\x82w  \n  \xc5\xbc\xc3\xb3\xc5\x82w"
+       "\n\n\n\n\n\n\n\n\n x",
+       "\xc5\xbc\xc3\xb3\xc5\x82w \xc5\xbc\xc3\xb3\xc5\x82w x"},
   };
 
   Evaluator test_clean("StringFormat::str_clean", tests);
@@ -331,8 +504,23 @@ Stats check_str_clean(bool verbose) {
       {{"    ", " \n"}, ""},
       {{"\n\n\n\n", "\n "}, ""},
       {{"\n\n \n", "\n "}, ""},
+      {{"\t\v A \r\n\f B\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\tC\r\n", ""},
+       "A B C"},
+      {{"\t\v A \r\n\f B\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\tC\r\n", "\t"},
+       "\v A \r\n\f B C\r\n"},
+      {{"a,,b;;c,;,d;e,,,,,,,,,,,,,,,,,,,,,,,,,,f, g", ",;"},
+       "a b c d e f g"},
+      {{"x" + string(130, ';') + "y" + string(64, ','), ",;"}, "x y"},
   };
 
+  // Runs of separators crossing boundaries of SIMD blocks.
+  for (size_t block : {16, 32, 64}) {
+    const string head(block - 2, 'a'), middle(block, 'b');
+    tests_with_chars.push_back(
+        {{head + ",;,;" + middle + ",ccc,,,", ",;"},
+         head + " " + middle + " ccc"});
+  }
+
   Evaluator test_clean_with_chars("StringFormat::str_clean", tests_with_chars);
 
   result(test_clean_with_chars.verify());
@@ -370,6 +558,41 @@ Stats check_str_join(bool verbose) {
   else if (test_join.hasFailed())
     cout << message.str() << test_join.failed << "\n";
 
+  message.str("");
+  message << "\nTesting quoted strings:\n";
+
+  vector<StrJoinQuoted> tests_quoted = {
+      {{}, ""},
+      {{"a"}, "\"a\""},
+      {{"a b", "", "say \"hi\"", "back\\slash"},
+       "\"a b\",\"\",\"say \\\"hi\\\"\",\"back\\\\slash\""},
+  };
+
+  Evaluator test_quoted("StringFormat::str_join_quoted", tests_quoted);
+  result(test_quoted.verify());
+
+  if (verbose)
+    cout << message.str() << test_quoted.message << "\n";
+  else if (test_quoted.hasFailed())
+    cout << message.str() << test_quoted.failed << "\n";
+
+  message.str("");
+  message << "\nTesting StringBuilder:\n";
+
+  vector<StringBuilderTest> tests_builder = {
+      {{"id", 7, 3, 0.5}, "id007 0.5 0.50"},
+      {{"", -42, 0, 1.0 / 3}, "-42 0.333333 0.33"},
+      {{"x", 123456, 2, 1e20}, "x123456 1e+20 100000000000000000000.00"},
+  };
+
+  Evaluator test_builder("StringFormat::StringBuilder", tests_builder);
+  result(test_builder.verify());
+
+  if (verbose)
+    cout << message.str() << test_builder.message << "\n";
+  else if (test_builder.hasFailed())
+    cout << message.str() << test_builder.failed << "\n";
+
   cout << "~~~ "
        << gen_summary(result, "Checking StringFormat::str_join function")
        << endl;
@@ -430,6 +653,13 @@ Stats check_str_split(bool verbose) {
       {{"__ABC____DEF__", "__"}, {"", "ABC", "", "DEF", ""}},
   };
 
+  // Fields crossing boundaries of 16, 32 and 64 byte blocks.
+  vector<string> fields{};
+  for (int i = 0; i < 100; ++i)
+    fields.push_back("f" + to_string(i));
+  tests.push_back({{StringCompose::str_join(fields, "\t"), "\t"}, fields});
+  tests.push_back({{string(130, ','), ","}, vector<string>(131)});
+
   Evaluator test_split("StringFormat::str_split", tests);
 
   result(test_split.verify());
@@ -439,6 +669,26 @@ Stats check_str_split(bool verbose) {
   else if (test_split.hasFailed())
     cout << message.str() << test_split.failed << "\n";
 
+  message.str("");
+  message << "\nTesting separator offsets:\n";
+
+  vector<StrSplitOffsets> tests_offsets = {
+      {{"", ','}, {}},
+      {{"ABC", ','}, {}},
+      {{",A,,B,", ','}, {0, 2, 3, 5}},
+      {{string(63, 'A') + ",A", ','}, {63}},
+      {{string(64, 'A') + ",A", ','}, {64}},
+      {{string(70, 'A') + ",", ','}, {70}},
+  };
+
+  Evaluator test_offsets("StringFormat::str_split_offsets", tests_offsets);
+  result(test_offsets.verify());
+
+  if (verbose)
+    cout << message.str() << test_offsets.message << "\n";
+  else if (test_offsets.hasFailed())
+    cout << message.str() << test_offsets.failed << "\n";
+
   cout << "~~~ "
        << gen_summary(result, "Checking StringFormat::str_split function")
        << endl;
@@ -446,6 +696,153 @@ Stats check_str_split(bool verbose) {
   return result;
 }
 
+Stats check_str_split_view(bool verbose) {
+  Stats result;
+  sstream message;
+
+  message << "\n~~~ Checking StringDecompose::str_split_view\n";
+
+  vector<StrSplitView> tests = {
+      {{"", "_"}, {}},
+      {{"", "__"}, {""}},
+      {{"ABC_DEF", ""}, {"ABC_DEF"}},
+      {{"_ABC__DEF_", "_"}, {"", "ABC", "", "DEF", ""}},
+      {{"_ABC__DEF_", "_", 0, false}, {"ABC", "DEF"}},
+      {{"__ABC____DEF__", "__"}, {"", "ABC", "", "DEF", ""}},
+      {{"__ABC____DEF__", "__", 0, false}, {"ABC", "DEF"}},
+      {{"A,B,C,D", ",", 0, true, true}, {"A", "B", "C,D"}},
+      {{"A,B", ",", 0, true, true}, {"A", "B"}},
+      {{"A::B::C::D", "::", 0, true, true}, {"A", "B", "C::D"}},
+      {{"A,\"B,C\",,D", ",", '"'}, {"A", "\"B,C\"", "", "D"}},
+      {{"A,\"B,C\",,D", ",", '"', false}, {"A", "\"B,C\"", "D"}},
+      {{"A,\"B,C\",D,E", ",", '"', true, true}, {"A", "\"B,C\"", "D,E"}},
+      {{"\"A,B\",\"C,D\",,\"E,F\"", ",", '"', false, true},
+       {"\"A,B\"", "\"C,D\"", ",\"E,F\""}},
+      {{"A,\"B,C", ",", '"'}, {"error"}},
+  };
+
+  Evaluator test_split("StringDecompose::str_split_view", tests);
+  result(test_split.verify());
+
+  if (verbose)
+    cout << message.str() << test_split.message << "\n";
+  else if (test_split.hasFailed())
+    cout << message.str() << test_split.failed << "\n";
+
+  message.str("");
+  message << "\nTesting quoted fields:\n";
+
+  // Long row puts quotes and separators across blocks of 64 bytes.
+  string row{};
+  PrintableVector<string> fields{};
+  for (int i = 0; i < 40; ++i) {
+    fields.value.push_back(i % 3 ? string(static_cast<size_t>(i), 'x')
+                                 : "\"" + string(static_cast<size_t>(i), ',') +
+                                       "\"\"\"");
+    row += (i ? "," : "") + fields.value.back();
+  }
+
+  vector<StrSplitQuoted> tests_quoted = {
+      {{""}, {}},
+      {{","}, {"", ""}},
+      {{"A,\"B,,C\",,D"}, {"A", "\"B,,C\"", "", "D"}},
+      {{"\"A\"\"B\",C"}, {"\"A\"\"B\"", "C"}},
+      {{"\"A,B"}, {"error"}},
+      {{"A\\,B,\"C\\\",D\",E", '\\'}, {"A\\,B", "\"C\\\",D\"", "E"}},
+      {{"A\\\\,B", '\\'}, {"A\\\\", "B"}},
+      {{row}, fields},
+  };
+
+  Evaluator test_quoted("StringDecompose::str_split_quoted", tests_quoted);
+  result(test_quoted.verify());
+
+  if (verbose)
+    cout << message.str() << test_quoted.message << "\n";
+  else if (test_quoted.hasFailed())
+    cout << message.str() << test_quoted.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result,
+                      "Checking StringDecompose::str_split_view function")
+       << endl;
+
+  return result;
+}
+
+Stats check_splitter(bool verbose) {
+  Stats result;
+  sstream message;
+
+  message << "\n~~~ Checking StringDecompose::Splitter\n";
+
+  vector<SplitterTest> tests = {
+      {{"", "||"}, {""}},
+      {{"A||B", ""}, {"A||B"}},
+      {{"A|B", "|"}, {"A", "B"}},
+      {{"||A||||B||", "||"}, {"", "A", "", "B", ""}},
+  };
+
+  // Separators served by every search method, fields crossing 16 and 32
+  // byte blocks and separator prefixes which are not separators.
+  for (const auto &sep : {string("|#|#|!"), string(40, '#') + "!",
+                          string(300, '-') + "+"}) {
+    vector<string> fields{};
+    for (int i = 0; i < 30; ++i)
+      fields.push_back(string(static_cast<size_t>(i), 'x') +
+                       sep.substr(0, sep.size() / 2));
+    fields.push_back("");
+    tests.push_back({{StringCompose::str_join(fields, sep), sep}, fields});
+  }
+
+  Evaluator test_splitter("StringDecompose::Splitter", tests);
+  result(test_splitter.verify());
+
+  if (verbose)
+    cout << message.str() << test_splitter.message << "\n";
+  else if (test_splitter.hasFailed())
+    cout << message.str() << test_splitter.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result, "Checking StringDecompose::Splitter class")
+       << endl;
+
+  return result;
+}
+
+Stats check_split_range(bool verbose) {
+  Stats result;
+  sstream message;
+
+  message << "\n~~~ Checking StringDecompose::split_range\n";
+
+  vector<SplitRangeTest> tests = {
+      {{"", "\t"}, {}},
+      {{"", "::"}, {""}},
+      {{"A", ""}, {"A"}},
+      {{"\tA\t\tB\t", "\t"}, {"", "A", "", "B", ""}},
+      {{"A\tB\tC\tD", "\t", 0, 1}, {"A"}},
+      {{"A\tB\tC\tD", "\t", 2}, {"C", "D"}},
+      {{"A\tB\tC\tD", "\t", 1, 2}, {"B", "C"}},
+      {{"A\tB\tC\tD", "\t", 4}, {}},
+      {{"::A::::B::", "::"}, {"", "A", "", "B", ""}},
+      {{"A::B::C", "::", 1, 1}, {"B"}},
+  };
+
+  Evaluator test_split("StringDecompose::split_range", tests);
+  result(test_split.verify());
+
+  if (verbose)
+    cout << message.str() << test_split.message << "\n";
+  else if (test_split.hasFailed())
+    cout << message.str() << test_split.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result, "Checking StringDecompose::split_range class")
+       << endl;
+
+  return result;
+}
+
 Stats check_str_replace(bool verbose) {
   Stats result;
   sstream message, failure;
@@ -469,6 +866,15 @@ Stats check_str_replace(bool verbose) {
       {{"__ABC__DEF__", "__", "+"}, {"+ABC+DEF+"}},
       {{"__ABC__DEF__", "_", "++"}, {"++++ABC++++DEF++++"}},
       {{"__ABC__DEF__", "__", "++"}, {"++ABC++DEF++"}},
+      {{"ABABA", "ABA", "+"}, {"+BA"}},
+      {{string(100, '_'), "__", "-+-"}, {[]() {
+         string result{};
+         for (int i = 0; i < 50; ++i)
+           result += "-+-";
+         return result;
+       }()}},
+      {{string(40, 'A') + "<tag>" + string(40, 'B') + "<tag>", "<tag>", ""},
+       {string(40, 'A') + string(40, 'B')}},
   };
 
   Evaluator test_replace("StringFormat::str_split", tests);
@@ -486,32 +892,40 @@ Stats check_str_replace(bool verbose) {
   return result;
 }
 
-Stats check_join_fields(bool verbose) {
+Stats check_str_replace_n(bool verbose) {
   Stats result;
-  sstream message, failure;
-
-  message << "\n~~~ Checking StringFormat::str_replace\n"
-          << "\nTesting strings with default parameters:\n";
+  sstream message;
 
-  vector<StrReplace> tests = {
-      {{"", "", ""}, {""}},
-      {{"", "*", ""}, {""}},
-      {{"", "*", "+"}, {""}},
-      {{"", "", "+"}, {""}},
-      {{"ABC_DEF", "", ""}, {"ABC_DEF"}},
-      {{"ABC_DEF", "", "+"}, {"ABC_DEF"}},
-      {{"ABC_DEF", "*", "+"}, {"ABC_DEF"}},
-      {{"ABC_DEF", "*", ""}, {"ABC_DEF"}},
-      {{"ABC_DEF", "_", ""}, {"ABCDEF"}},
-      {{"__ABC__DEF__", "_", ""}, {"ABCDEF"}},
-      {{"__ABC__DEF__", "__", ""}, {"ABCDEF"}},
-      {{"__ABC__DEF__", "_", "+"}, {"++ABC++DEF++"}},
-      {{"__ABC__DEF__", "__", "+"}, {"+ABC+DEF+"}},
-      {{"__ABC__DEF__", "_", "++"}, {"++++ABC++++DEF++++"}},
-      {{"__ABC__DEF__", "__", "++"}, {"++ABC++DEF++"}},
+  message << "\n~~~ Checking StringFormat::str_replace_n\n";
+
+  vector<StrReplaceN> tests = {
+      {{"", {{"A", "B"}}}, ""},
+      {{"ABC", {}}, "ABC"},
+      {{"ABC", {{"", "X"}}}, "ABC"},
+      {{"A_B-C", {{"_", "+"}, {"-", ""}}}, "A+BC"},
+      {{"AB", {{"A", "B"}, {"B", "A"}}}, "BA"},
+      {{"ABCD", {{"BC", "1"}, {"ABC", "2"}}}, "2D"},
+      {{"ABCD", {{"AB", "1"}, {"ABCD", "2"}, {"ABC", "3"}}}, "2"},
+      {{"ABCD", {{"BCD", "1"}, {"AB", "2"}}}, "2CD"},
+      {{"XABCX", {{"ABCE", "1"}, {"BC", "2"}}}, "XA2X"},
+      {{"AAAA", {{"AA", "B"}}}, "BB"},
+      {{"AAA", {{"AA", "B"}}}, "BA"},
+      {{"ENSG1.5;ENSG2.12", {{".5", ""}, {".12", ""}, {"ENSG", "G"}}},
+       "G1;G2"},
   };
 
-  Evaluator test_replace("StringFormat::str_split", tests);
+  // Long pattern is partially matched at every position, matches cross
+  // blocks of positions scanned at once.
+  const auto partial = string(3000, 'A') + "B";
+  tests.push_back({{string(5000, 'A'), {{partial, "X"}, {"A", "1"}}},
+                   string(5000, '1')});
+  tests.push_back(
+      {{"A" + partial + "A", {{partial, "X"}, {"A", "1"}}}, "1X1"});
+  tests.push_back({{string(1020, 'C') + "ABCDEFG" + string(2050, 'C'),
+                    {{"ABCDEFG", "Z"}, {string(1024, 'C'), "Y"}}},
+                   string(1020, 'C') + "ZYYCC"});
+
+  Evaluator test_replace("StringFormat::str_replace_n", tests);
   result(test_replace.verify());
 
   if (verbose)
@@ -520,7 +934,37 @@ Stats check_join_fields(bool verbose) {
     cout << message.str() << test_replace.failed << "\n";
 
   cout << "~~~ "
-       << gen_summary(result, "Checking StringFormat::str_replace function")
+       << gen_summary(result, "Checking StringFormat::str_replace_n function")
+       << endl;
+
+  return result;
+}
+
+Stats check_join_fields(bool verbose) {
+  Stats result;
+  sstream message, failure;
+
+  message << "\n~~~ Checking StringFormat::str_join_fields\n"
+          << "\nTesting fields:\n";
+
+  vector<StrJoinFields> tests = {
+      {"", ""},
+      {"a=1", "a:1"},
+      {"a=1;b;c=3", "a:1|b|c:3"},
+      {"name=two words;note= padded ", "name:two words|note: padded "},
+      {"a=;b=x\ty", "a:|b:x\ty"},
+  };
+
+  Evaluator test_fields("StringFormat::str_join_fields", tests);
+  result(test_fields.verify());
+
+  if (verbose)
+    cout << message.str() << test_fields.message << "\n";
+  else if (test_fields.hasFailed())
+    cout << message.str() << test_fields.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result, "Checking StringFormat::str_join_fields function")
        << endl;
 
   return result;
@@ -547,6 +991,411 @@ Stats check_open_file(bool verbose = false) {
   return result;
 }
 
+Stats check_file_reader(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::FileReader\n";
+
+  vector<ReadFile> tests;
+  for (auto mode : {Files::ReadMode::Stream, Files::ReadMode::Block,
+                    Files::ReadMode::ReadAhead, Files::ReadMode::Mapped,
+                    Files::ReadMode::Uring}) {
+    tests.push_back({{"", mode}, {}});
+    tests.push_back({{"A\n", mode}, {"1:A"}});
+    tests.push_back({{"A\nB", mode}, {"1:A"}});
+    tests.push_back({{"A\n\nB\n", mode}, {"1:A", "2:", "3:B"}});
+    tests.push_back({{"#A\nB\n#C\nD\n", mode, "#"}, {"2:B", "4:D"}});
+  }
+
+  const string line(3000, 'A');
+  tests.push_back({{line + "\n" + line + "\n", Files::ReadMode::Block, "", 1},
+                   {"1:" + line, "2:" + line}});
+  tests.push_back({{"B\n" + line + line + line + "\nC\n",
+                    Files::ReadMode::Block, "", 1},
+                   {"1:B", "2:" + line + line + line, "3:C"}});
+  tests.push_back({{"B\n" + line + line + line + "\nC\n",
+                    Files::ReadMode::ReadAhead, "", 1},
+                   {"1:B", "2:" + line + line + line, "3:C"}});
+  tests.push_back({{"B\n" + line + line + line + "\nC\n",
+                    Files::ReadMode::Uring, "", 1},
+                   {"1:B", "2:" + line + line + line, "3:C"}});
+
+  Evaluator test_reader("Files::FileReader", tests);
+  result(test_reader.verify());
+
+  if (verbose)
+    cout << message.str() << test_reader.message << "\n";
+  else if (test_reader.hasFailed())
+    cout << message.str() << test_reader.failed << "\n";
+
+  cout << "~~~ " << gen_summary(result, "Checking Files::FileReader class")
+       << endl;
+
+  return result;
+}
+
+Stats check_multi_file_reader(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::MultiFileReader\n";
+
+  const vector<string> contents{"a\nbb\nccc\n", "", "dddd\ne", "f\ng\nh\n"};
+  const PrintableVector<string> expected{
+      {"0:a", "0:bb", "0:ccc", "2:dddd", "2:e", "3:f", "3:g", "3:h",
+       "4 files 8 lines 21 bytes"}};
+
+  vector<ReadShards> tests = {
+      {{contents, 1, 1 << 20}, expected},
+      {{contents, 4, 1 << 20}, expected},
+      {{contents, 3, 1}, expected},
+      {{contents, 2, 3}, expected},
+      {{{}, 2, 1}, {"0 files 0 lines 0 bytes"}},
+  };
+
+  Evaluator test_reader("Files::MultiFileReader", tests);
+  result(test_reader.verify());
+
+  if (verbose)
+    cout << message.str() << test_reader.message << "\n";
+  else if (test_reader.hasFailed())
+    cout << message.str() << test_reader.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result, "Checking Files::MultiFileReader class")
+       << endl;
+
+  return result;
+}
+
+Stats check_uring_reader(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::UringSource\n";
+
+  const string line(5000, 'A');
+  const string content{"B\n" + line + "\n\n" + line + line + "\nC"};
+  const PrintableVector<string> one{{"5:15002"}};
+  const PrintableVector<string> three{{"5:15002", "5:15002", "5:15002"}};
+
+  vector<ReadUring> tests = {
+      {{content, true, 1}, one},  {{content, true, 3}, three},
+      {{content, false, 1}, one}, {{content, false, 3}, three},
+      {{"", true, 2}, {"0:0", "0:0"}},
+  };
+
+  Evaluator test_reader("Files::UringSource", tests);
+  result(test_reader.verify());
+
+  if (verbose)
+    cout << message.str() << test_reader.message << "\n";
+  else if (test_reader.hasFailed())
+    cout << message.str() << test_reader.failed << "\n";
+
+  cout << "~~~ " << gen_summary(result, "Checking Files::UringSource class")
+       << endl;
+
+  return result;
+}
+
+Stats check_file_reader_wide(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::FileReaderWide\n";
+
+  const string ascii(40, 'a');
+  vector<ReadFileWide> tests = {
+      {"abc\n\ndef\n", {"3", "0", "3"}},
+      {"za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87\n", {"6 U+17c U+f3 U+142 U+107"}},
+      {ascii + "\xe2\x82\xac" + ascii + "\xf0\x9f\x98\x80\n",
+       {"82 U+20ac U+1f600"}},
+      {"a\n" + ascii + "\xc0\xaf\n", {"1", "invalid:2"}},
+      {"\xed\xa0\x80\n", {"invalid:1"}},
+      {"\xf4\x90\x80\x80\n", {"invalid:1"}},
+      {ascii + "\xe2\x82\n", {"invalid:1"}},
+      {ascii + ascii + "\x80\n", {"invalid:1"}},
+  };
+
+  Evaluator test_reader("Files::FileReaderWide", tests);
+  result(test_reader.verify());
+
+  if (verbose)
+    cout << message.str() << test_reader.message << "\n";
+  else if (test_reader.hasFailed())
+    cout << message.str() << test_reader.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result, "Checking Files::FileReaderWide class") << endl;
+
+  return result;
+}
+
+Stats check_parallel_reader(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::ParallelReader\n";
+
+  vector<ParallelRead> tests = {
+      {{"", 4}, {}},
+      {{"A\n", 4}, {"1:A"}},
+      {{"A\nB", 1}, {"1:A", "2:B"}},
+      {{"A\nB\nC\nD\n", 2}, {"1:A", "2:B", "3:C", "4:D"}},
+      {{"A\nB\nC\nD\n", 3}, {"1:A", "2:B", "3:C", "4:D"}},
+      {{"AAAA\nB\n\nD", 8}, {"1:AAAA", "2:B", "3:", "4:D"}},
+      {{"A\nBBBBBBBBBB\nC\n", 5}, {"1:A", "2:BBBBBBBBBB", "3:C"}},
+  };
+
+  Evaluator test_reader("Files::ParallelReader", tests);
+  result(test_reader.verify());
+
+  if (verbose)
+    cout << message.str() << test_reader.message << "\n";
+  else if (test_reader.hasFailed())
+    cout << message.str() << test_reader.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result, "Checking Files::ParallelReader class") << endl;
+
+  return result;
+}
+
+Stats check_compressed_reader(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::FileReader with compressed input\n";
+
+#ifdef AGIZMO_ZLIB
+  vector<ReadCompressed> tests = {
+      {{"A\nB\n", 0}, {"1:A", "2:B"}},
+      {{"A\nBB\nCCC\n", 0}, {"1:A", "2:BB", "3:CCC"}},
+      {{"A\nB\n", 100}, {"1:A", "2:B"}},
+      {{"A\nBB\nCCC\n", 1}, {"1:A", "2:BB", "3:CCC"}},
+      {{"A\nBB\nCCC\n", 3}, {"1:A", "2:BB", "3:CCC"}},
+  };
+
+  Evaluator test_reader("Files::FileReader", tests);
+  result(test_reader.verify());
+
+  if (verbose)
+    cout << message.str() << test_reader.message << "\n";
+  else if (test_reader.hasFailed())
+    cout << message.str() << test_reader.failed << "\n";
+
+  message.str("");
+  message << "\nTesting workers of BGZF source:\n";
+
+  const auto all = to_string(Files::default_workers());
+  vector<BgzfWorkers> tests_workers = {
+      {0, all + ":A:B:C"},
+      {1, "1:A:B:C"},
+      {2, "3:A:B:C"},
+  };
+
+  Evaluator test_workers("Files::BgzfSource", tests_workers);
+  result(test_workers.verify());
+
+  if (verbose)
+    cout << message.str() << test_workers.message << "\n";
+  else if (test_workers.hasFailed())
+    cout << message.str() << test_workers.failed << "\n";
+#else
+  cout << message.str() << "Skipped, built without zlib\n";
+#endif
+
+  cout << "~~~ "
+       << gen_summary(result,
+                      "Checking Files::FileReader with compressed input")
+       << endl;
+
+  return result;
+}
+
+Stats check_seek_line(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::FileReader::seekLine\n";
+
+  vector<SeekLine> tests;
+  for (auto mode : {Files::ReadMode::Stream, Files::ReadMode::Block,
+                    Files::ReadMode::Mapped, Files::ReadMode::Uring}) {
+    tests.push_back({{mode, 1, 1}, "1:L1"});
+    tests.push_back({{mode, 1, 20}, "20:L20"});
+    tests.push_back({{mode, 3, 7}, "7:L7"});
+    tests.push_back({{mode, 3, 9}, "9:L9"});
+    tests.push_back({{mode, 30, 15}, "15:L15"});
+  }
+
+  Evaluator test_seek("Files::FileReader::seekLine", tests);
+  result(test_seek.verify());
+
+  if (verbose)
+    cout << message.str() << test_seek.message << "\n";
+  else if (test_seek.hasFailed())
+    cout << message.str() << test_seek.failed << "\n";
+
+  message.str("");
+  message << "\nTesting sidecar index:\n";
+
+  vector<LoadLineIndex> tests_index = {
+      {"none", "loaded:20:7|20:L20"},     {"rewrite", "rejected|20:LL20"},
+      {"step", "rejected|20:L20"},        {"count", "rejected|20:L20"},
+      {"order", "rejected|20:L20"},       {"range", "rejected|20:L20"},
+      {"truncate", "rejected|20:L20"},
+  };
+
+  Evaluator test_index("Files::LineIndex::load", tests_index);
+  result(test_index.verify());
+
+  if (verbose)
+    cout << message.str() << test_index.message << "\n";
+  else if (test_index.hasFailed())
+    cout << message.str() << test_index.failed << "\n";
+
+  cout << "~~~ "
+       << gen_summary(result, "Checking Files::FileReader::seekLine function")
+       << endl;
+
+  return result;
+}
+
+Stats check_record_reader(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::RecordReader\n";
+
+  vector<ReadRecords> tests = {
+      {{"", ','}, {}},
+      {{"1,A\n", ','}, {"1:1|A:1"}},
+      {{"1,A\n2,B", ','}, {"1:1|A:1", "2:2|B:2"}},
+      {{"#C\n1,,A,\n\n", ',', "#"}, {"2:1||A|:1", "3::-1"}},
+      {{"-7\tA\nX\tB\n", '\t'}, {"1:-7|A:-7", "2:X|B:-1"}},
+  };
+
+  Evaluator test_reader("Files::RecordReader", tests);
+  result(test_reader.verify());
+
+  if (verbose)
+    cout << message.str() << test_reader.message << "\n";
+  else if (test_reader.hasFailed())
+    cout << message.str() << test_reader.failed << "\n";
+
+  message.str("");
+  message << "\nTesting column projection:\n";
+
+  const string table{"a,b,c,d\n1,2,3,4\n5,6\n"};
+  vector<ProjectRecords> tests_projected = {
+      {{table, {0}}, {"a", "1", "5"}},
+      {{table, {3, 1}}, {"d|b", "4|2", "|6"}},
+      {{table, {1, 1}}, {"b|b", "2|2", "6|6"}},
+      {{table, {}, {"c", "a"}}, {"3|1", "|5"}},
+  };
+
+  Evaluator test_projected("Files::RecordReader::project", tests_projected);
+  result(test_projected.verify());
+
+  if (verbose)
+    cout << message.str() << test_projected.message << "\n";
+  else if (test_projected.hasFailed())
+    cout << message.str() << test_projected.failed << "\n";
+
+  cout << "~~~ " << gen_summary(result, "Checking Files::RecordReader class")
+       << endl;
+
+  return result;
+}
+
+Stats check_csv_reader(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::CsvReader\n";
+
+  // Unquoted row longer than block of 64 bytes.
+  string row{};
+  for (int i = 0; i < 30; ++i)
+    row += (i ? "," : "") + to_string(i * 1000);
+
+  // Quoted field of 50000 lines, read in linear time.
+  string field{};
+  for (int i = 0; i < 50000; ++i)
+    field += (i ? "\n" : "") + to_string(i) + ",\"\"";
+  const auto unquoted = StringFormat::str_replace(field, "\"\"", "\"");
+
+  vector<ReadCsv> tests = {
+      {"", {}},
+      {"1,A\n2,B", {"1:1|A", "2:2|B"}},
+      {"1,,A,\n\n", {"1:1||A|", "2:"}},
+      {"\"A,B\",C\r\nD,\"\"\r\n", {"1:A,B|C", "2:D|"}},
+      {"\"say \"\"hi\"\"\",\"\"\"\"\"\"\n", {"1:say \"hi\"|\"\""}},
+      {"A,\"multi\nline\n\nfield\",B\nC\n",
+       {"4:A|multi\nline\n\nfield|B", "5:C"}},
+      {"A,\"x\"\"\r\ny\"\n", {"2:A|x\"\r\ny"}},
+      {"A\n\"open,\nfield\n", {"1:A", "error"}},
+      {"5\",A,B\"", {"1:5\"|A|B\""}},
+      {"b\"c,d", {"1:b\"c|d"}},
+      {"\"a\",b\"c,d", {"1:a|b\"c|d"}},
+      {"\"a,b\",c\"d,\"e\"\n", {"1:a,b|c\"d|e"}},
+      {"\"a\"x\"y,z", {"1:\"a\"x\"y|z"}},
+      {row + "\n" + row, {"1:" + StringFormat::str_replace(row, ",", "|"),
+                          "2:" + StringFormat::str_replace(row, ",", "|")}},
+      {"A,\"" + field + "\",B\r\nC\n",
+       {"50000:A|" + unquoted + "|B", "50001:C"}},
+  };
+
+  Evaluator test_reader("Files::CsvReader", tests);
+  result(test_reader.verify());
+
+  if (verbose)
+    cout << message.str() << test_reader.message << "\n";
+  else if (test_reader.hasFailed())
+    cout << message.str() << test_reader.failed << "\n";
+
+  cout << "~~~ " << gen_summary(result, "Checking Files::CsvReader class")
+       << endl;
+
+  return result;
+}
+
+Stats check_file_writer(bool verbose = false) {
+  Stats result;
+  sstream message;
+  message << "\n~~~ Checking Files::FileWriter\n";
+
+  string expected{"A\t1\t-2\t0.5\t" + string(5000, 'B') +
+                  "\nx,42\n18446744073709551615 0.1 0.667\n-1;0;1\n"
+                  "1,2\n3,4\n"};
+  for (int i = 0; i < 100; ++i)
+    expected += to_string(i) + "," + to_string(i * i) + "\n";
+  // Large numbers in fixed notation are longer than any small buffer.
+  for (const auto &[number, precision] : {pair{1e100, 2}, pair{-1e300, 0}}) {
+    char text[400];
+    const auto last = std::to_chars(text, text + sizeof(text), number,
+                                    std::chars_format::fixed, precision)
+                          .ptr;
+    expected += string(text, last) + "\n";
+  }
+  expected += "x;y\n";
+
+  // Small buffers are flushed many times.
+  vector<WriteFile> tests = {
+      {1, expected},
+      {100, expected},
+      {4096, expected},
+      {Files::default_block_size, expected},
+  };
+
+  Evaluator test_writer("Files::FileWriter", tests);
+  result(test_writer.verify());
+
+  if (verbose)
+    cout << message.str() << test_writer.message << "\n";
+  else if (test_writer.hasFailed())
+    cout << message.str() << test_writer.failed << "\n";
+
+  cout << "~~~ " << gen_summary(result, "Checking Files::FileWriter class")
+       << endl;
+
+  return result;
+}
+
 // pair_int check_str_map_fields(bool verbose = false) {
 //   int total = 0, failed = 0;
 //   cout << "~~~ Checking str_map_fields function" << endl;
@@ -594,17 +1443,35 @@ int perform_tests(bool verbose) {
 
   cout << "\n>>> Checking String functions" << endl;
   result(check_only_digits(verbose));
+  result(check_str_search(verbose));
   result(check_str_to_int(verbose));
+  result(check_str_to_number(verbose));
+  result(check_str_double(verbose));
   result(check_str_clean_ends(verbose));
   result(check_str_clean(verbose));
   result(check_str_join(verbose));
+  result(check_join_fields(verbose));
   result(check_str_reverse(verbose));
   result(check_str_split(verbose));
+  result(check_str_split_view(verbose));
+  result(check_split_range(verbose));
+  result(check_splitter(verbose));
   result(check_str_replace(verbose));
+  result(check_str_replace_n(verbose));
   cout << ">>> Done\n";
 
   cout << "\n>>> Checking Files functions" << endl;
   result(check_open_file(verbose));
+  result(check_file_reader(verbose));
+  result(check_uring_reader(verbose));
+  result(check_file_reader_wide(verbose));
+  result(check_parallel_reader(verbose));
+  result(check_multi_file_reader(verbose));
+  result(check_compressed_reader(verbose));
+  result(check_seek_line(verbose));
+  result(check_record_reader(verbose));
+  result(check_csv_reader(verbose));
+  result(check_file_writer(verbose));
   cout << ">>> Done\n";
 
   cout << "\n" << gen_summary(result, "Evaluation", true) << "\n";
@@ -657,6 +1524,53 @@ StrToInt::StrToInt(string input, PrintableOptional<int> expected)
   validate();
 }
 
+StrToDouble::StrToDouble(string input, PrintableOptional<double> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StrToNumbers::StrToNumbers(string input, PrintableVector<int64_t> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StrDouble::StrDouble(StrDoubleInput input, string expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StrJoinQuoted::StrJoinQuoted(PrintableVector<string> input, string expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StrJoinFields::StrJoinFields(string input, string expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StringBuilderTest::StringBuilderTest(StringBuilderInput input,
+                                     string expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StrSplitQuoted::StrSplitQuoted(StrSplitQuotedInput input,
+                               PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+ReadCsv::ReadCsv(string input, PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StrSearch::StrSearch(StrSearchInput input, PrintableVector<long> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
 StrCleanEnds::StrCleanEnds(string input, string expected)
     : BaseTest(input, expected) {
   validate();
@@ -701,3 +1615,97 @@ OpenFile::OpenFile(std::string input, std::string expected)
     : BaseTest(input, expected) {
   validate();
 }
+
+ReadFile::ReadFile(ReadFileInput input, PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+ParallelRead::ParallelRead(ParallelReadInput input,
+                           PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+#ifdef AGIZMO_ZLIB
+ReadCompressed::ReadCompressed(ReadCompressedInput input,
+                               PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+BgzfWorkers::BgzfWorkers(int input, string expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+#endif
+
+SeekLine::SeekLine(SeekLineInput input, string expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+LoadLineIndex::LoadLineIndex(string input, string expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+ReadRecords::ReadRecords(ReadRecordsInput input,
+                         PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+ProjectRecords::ProjectRecords(ProjectRecordsInput input,
+                               PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+WriteFile::WriteFile(size_t input, string expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+ReadFileWide::ReadFileWide(string input, PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+ReadUring::ReadUring(ReadUringInput input, PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+ReadShards::ReadShards(ReadShardsInput input, PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StrSplitOffsets::StrSplitOffsets(StrSplitOffsetsInput input,
+                                 PrintableVector<size_t> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StrSplitView::StrSplitView(StrSplitViewInput input,
+                           PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+SplitRangeTest::SplitRangeTest(SplitRangeInput input,
+                               PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+SplitterTest::SplitterTest(pair_str input, PrintableVector<string> expected)
+    : BaseTest(input, expected) {
+  validate();
+}
+
+StrReplaceN::StrReplaceN(StrReplaceNInput input, string expected)
+    : BaseTest(input, expected) {
+  validate();
+}